@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Micro-benchmarks that need no database. Each one registers itself under a name with a static
+// Bench::Registration and is run by bench/main.cpp, either by name or all in turn.
+class Bench
+{
+public:
+    using Run = void (*)();
+
+    struct Registration
+    {
+        Registration(const char *name, Run run);
+    };
+
+    // Heap allocations made through operator new since the program started, counted by bench/main.cpp.
+    static std::uint64_t allocations();
+    static std::uint64_t allocatedBytes();
+
+    // CPU time used by the whole process, every thread included.
+    static std::chrono::nanoseconds processCpuTime();
+
+    // Nanoseconds per call of operation, over enough calls to take at least minimum.
+    template <typename Operation>
+    static double nanosPerCall(Operation &&operation, std::chrono::milliseconds minimum = std::chrono::milliseconds(200))
+    {
+        using Clock = std::chrono::steady_clock;
+        std::uint64_t calls = 0;
+        Clock::time_point start = Clock::now();
+        Clock::duration elapsed;
+        do
+        {
+            for (int i = 0; i < 64; i++)
+                operation();
+            calls += 64;
+            elapsed = Clock::now() - start;
+        } while (elapsed < minimum);
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / calls;
+    }
+
+    // Prints p50, p90, p99 and the maximum of samples given in nanoseconds.
+    static inline void printPercentiles(const char *label, std::vector<std::int64_t> &samples)
+    {
+        if (samples.empty())
+            return;
+        std::sort(samples.begin(), samples.end());
+        auto at = [&samples](std::size_t percent)
+        { return samples[std::min(samples.size() - 1, samples.size() * percent / 100)] / 1000.0; };
+        printf("%-36s p50 %8.1f us  p90 %8.1f us  p99 %8.1f us  max %8.1f us\n", label, at(50), at(90), at(99),
+               samples.back() / 1000.0);
+    }
+};
@@ -0,0 +1,93 @@
+#include "Bench.hpp"
+
+#include <HttpParser.hpp>
+
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+// Nanoseconds and heap allocations per request for HttpParser, over requests the way load balancers
+// and clients send them, parsed whole and as they arrive in small reads.
+namespace
+{
+    struct Capture
+    {
+        const char *name;
+        std::string text;
+    };
+
+    Capture captures[] = {
+        {"GET with query",
+         "GET /books/fetchAll?limit=100&after_id=0190f5a4-7c1e-7b3a-9d2e-3f4a5b6c7d8e&fields=title,author HTTP/1.1\r\n"
+         "Host: api.internal:8080\r\n"
+         "User-Agent: Envoy/1.29\r\n"
+         "Accept: application/json\r\n"
+         "Accept-Encoding: gzip, deflate\r\n"
+         "X-Request-Id: 4f6c2b7e-1a3d-4e5f-8a9b-0c1d2e3f4a5b\r\n"
+         "X-Forwarded-For: 10.12.4.7\r\n"
+         "Connection: keep-alive\r\n"
+         "\r\n"},
+        {"POST create",
+         "POST /books/create HTTP/1.1\r\n"
+         "Host: api.internal:8080\r\n"
+         "User-Agent: Envoy/1.29\r\n"
+         "Content-Type: application/json; charset=utf-8\r\n"
+         "Content-Length: 110\r\n"
+         "X-Request-Id: 9a8b7c6d-5e4f-4a3b-2c1d-0e9f8a7b6c5d\r\n"
+         "Connection: keep-alive\r\n"
+         "\r\n"
+         "{\"author\":\"Ursula K. Le Guin\",\"title\":\"The Left Hand of Darkness\",\"genre\":\"Science Fiction\",\"publisher\":\"Ace\"}"},
+        {"GET by id",
+         "GET /books/0190f5a4-7c1e-7b3a-9d2e-3f4a5b6c7d8e HTTP/1.1\r\n"
+         "Host: api.internal:8080\r\n"
+         "\r\n"},
+    };
+
+    void parseWhole(const Capture &capture)
+    {
+        HttpParser parser(1 << 20);
+        std::string_view buffer = capture.text;
+        std::uint64_t allocations = Bench::allocations();
+        double nanos = Bench::nanosPerCall([&parser, buffer]
+                                           {
+                                               parser.reset();
+                                               if (parser.parse(buffer) != HttpParser::State::Complete)
+                                                   std::abort(); });
+        printf("%-16s %-14s %8.1f ns/request  %llu allocations\n", capture.name, "whole", nanos,
+               static_cast<unsigned long long>(Bench::allocations() - allocations));
+    }
+
+    // The parser sees the buffer grow by chunk bytes per call, as it would across partial reads.
+    void parseInChunks(const Capture &capture, std::size_t chunk)
+    {
+        HttpParser parser(1 << 20);
+        std::string_view buffer = capture.text;
+        std::uint64_t allocations = Bench::allocations();
+        double nanos = Bench::nanosPerCall([&parser, buffer, chunk]
+                                           {
+                                               parser.reset();
+                                               HttpParser::State state = HttpParser::State::RequestLine;
+                                               for (std::size_t size = chunk; state != HttpParser::State::Complete; size += chunk)
+                                               {
+                                                   state = parser.parse(buffer.substr(0, std::min(size, buffer.size())));
+                                                   if (state == HttpParser::State::Error || (size >= buffer.size() && state != HttpParser::State::Complete))
+                                                       std::abort();
+                                               } });
+        char label[32];
+        snprintf(label, sizeof(label), "%zu-byte reads", chunk);
+        printf("%-16s %-14s %8.1f ns/request  %llu allocations\n", capture.name, label, nanos,
+               static_cast<unsigned long long>(Bench::allocations() - allocations));
+    }
+
+    void run()
+    {
+        for (const Capture &capture : captures)
+        {
+            parseWhole(capture);
+            parseInChunks(capture, 64);
+            parseInChunks(capture, 7);
+        }
+    }
+
+    Bench::Registration registration("parser", run);
+}
@@ -0,0 +1,103 @@
+#include "Bench.hpp"
+
+#include <Entity.hpp>
+#include <EntityCache.hpp>
+#include <Field.hpp>
+#include <Json.hpp>
+#include <RequestArena.hpp>
+
+#include <cstdlib>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Heap allocations per request for the handler work that needs no database: createUpdate updating a
+// book, and idOperation finding one in the entity cache. The parser's scratch memory comes from the heap,
+// as it did before the request arena, and then from the arena. What the arena leaves on the heap are the
+// entity's string fields, the cache key and the response body, which all outlive the parse.
+namespace
+{
+    // The same columns as Entities::Book, which needs the database headers.
+    using BookEntity = Entity<Field<"id", std::string>, Field<"author", std::string>, Field<"title", std::string>,
+                              Field<"genre", std::string>, Field<"publisher", std::string>>;
+    using Handler = std::string (*)(std::string_view body, std::pmr::memory_resource *arena, EntityCache &cache);
+
+    const char table[] = "book";
+    const char id[] = "0190f5a4-7c1e-7b3a-9d2e-3f4a5b6c7d8e";
+    std::size_t volatile sink;
+
+    // createUpdate for an update. The key is a copy, standing in for Database::idKey, which needs a session.
+    std::string update(std::string_view body, std::pmr::memory_resource *arena, EntityCache &cache)
+    {
+        std::optional<BookEntity> entity;
+        Json::parse(body, entity, arena);
+        if (!entity.has_value())
+            std::abort();
+        std::string key(getField<0>(entity.value()).value);
+        cache.invalidate(table, key);
+        return Json::toJson(entity.value());
+    }
+
+    // idOperation for an id whose entity is cached.
+    std::string fetchById(std::string_view body, std::pmr::memory_resource *arena, EntityCache &cache)
+    {
+        std::optional<std::string> requested = Json::parseId(body, arena);
+        if (!requested.has_value())
+            std::abort();
+        std::string key(requested.value());
+        std::optional<std::string> cached = cache.find(table, key);
+        if (!cached.has_value())
+            std::abort();
+        return std::move(cached.value());
+    }
+
+    void measure(const char *label, Handler handle, const std::string &body, EntityCache &cache)
+    {
+        static constexpr int requests = 10000;
+
+        RequestArena &arena = RequestArena::local();
+        for (bool arenaUsed : {false, true})
+        {
+            // new_delete_resource hands the parser the same blocks rapidjson's own allocator would take
+            // with malloc, but through operator new, where they are counted.
+            std::pmr::memory_resource *resource = arenaUsed ? arena.resource() : std::pmr::new_delete_resource();
+            auto request = [handle, &body, resource, &cache, &arena]
+            {
+                sink = handle(body, resource, cache).size();
+                arena.reset();
+            };
+            request();
+
+            std::uint64_t allocations = Bench::allocations();
+            std::uint64_t bytes = Bench::allocatedBytes();
+            for (int i = 0; i < requests; i++)
+                request();
+            allocations = Bench::allocations() - allocations;
+            bytes = Bench::allocatedBytes() - bytes;
+
+            double nanos = Bench::nanosPerCall(request);
+            printf("%-12s %-6s %7.1f ns/request  %5.2f allocations/request  %7.1f heap bytes/request\n", label,
+                   arenaUsed ? "arena" : "heap", nanos, static_cast<double>(allocations) / requests,
+                   static_cast<double>(bytes) / requests);
+        }
+    }
+
+    void run()
+    {
+        std::string book = "{\"id\":\"";
+        book += id;
+        book += "\",\"author\":\"Ursula K. Le Guin\",\"title\":\"The Left Hand of Darkness\","
+                "\"genre\":\"Science Fiction\",\"publisher\":\"Ace\"}";
+        std::string byId = "{\"id\":\"";
+        byId += id;
+        byId += "\"}";
+
+        EntityCache cache;
+        measure("update", update, book, cache);
+        cache.store(table, id, book, cache.version(table, id));
+        measure("fetchById", fetchById, byId, cache);
+    }
+
+    Bench::Registration registration("requests", run);
+}
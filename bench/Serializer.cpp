@@ -0,0 +1,104 @@
+#include "Bench.hpp"
+
+#include <Entity.hpp>
+#include <Field.hpp>
+#include <Json.hpp>
+
+#include <string>
+#include <vector>
+
+// Serializing 100k books the way fetchAll does: into one buffer sized from the row count, row by row
+// into one growing buffer as the streaming path does, and as one string per row appended to the
+// output, which is what the serializer used to do. Reports time, heap allocations and heap bytes per
+// row next to the size of each row's JSON; heap bytes beyond the output were reserved unused or
+// copied when the buffer grew.
+namespace
+{
+    // The same columns as Entities::Book, which needs the database headers.
+    using BookEntity = Entity<Field<"id", std::string>, Field<"author", std::string>, Field<"title", std::string>,
+                              Field<"genre", std::string>, Field<"publisher", std::string>>;
+
+    static constexpr std::size_t rows = 100000;
+
+    std::vector<BookEntity> books()
+    {
+        static const char *authors[] = {"Ursula K. Le Guin", "Gabriel García Márquez", "Chimamanda Ngozi Adichie",
+                                        "Haruki Murakami", "Toni Morrison"};
+        static const char *titles[] = {"The Left Hand of Darkness", "One Hundred Years of Solitude",
+                                       "Half of a Yellow Sun", "Hard-Boiled Wonderland and the End of the World",
+                                       "The \"Bluest\" Eye"};
+        static const char *genres[] = {"Science Fiction", "Magical Realism", "Historical Fiction", "Literary Fiction"};
+        static const char *publishers[] = {"Ace", "Harper & Row", "Fourth Estate", "Vintage International", "Knopf"};
+
+        std::vector<BookEntity> books(rows);
+        for (std::size_t i = 0; i < rows; i++)
+        {
+            char id[40];
+            snprintf(id, sizeof(id), "0190f5a4-7c1e-7b3a-9d2e-%012zx", i);
+            getField<0>(books[i]).value = id;
+            getField<1>(books[i]).value = authors[i % 5];
+            getField<2>(books[i]).value = std::string(titles[(i / 5) % 5]) + " " + std::to_string(i);
+            getField<3>(books[i]).value = genres[i % 4];
+            getField<4>(books[i]).value = publishers[(i / 3) % 5];
+        }
+        return books;
+    }
+
+    std::string perRowStrings(const std::vector<BookEntity> &books)
+    {
+        std::string json = "{\"success\":true,\"size\":";
+        json += std::to_string(books.size());
+        json += ",\"entities\":[";
+        for (std::size_t i = 0; i < books.size(); i++)
+        {
+            if (i)
+                json += ',';
+            json += Json::toJson<false>(books[i]);
+        }
+        json += "]}";
+        return json;
+    }
+
+    std::string oneBuffer(const std::vector<BookEntity> &books)
+    {
+        return Json::toJson(books);
+    }
+
+    std::string eachRow(const std::vector<BookEntity> &books)
+    {
+        return Json::toJsonEach<BookEntity>([&books](auto &&consumer)
+                                            {
+                                                for (const BookEntity &book : books)
+                                                    if (!consumer(book))
+                                                        break; });
+    }
+
+    void measure(const char *label, std::string (*serialize)(const std::vector<BookEntity> &),
+                 const std::vector<BookEntity> &books)
+    {
+        std::uint64_t allocations = Bench::allocations();
+        std::uint64_t bytes = Bench::allocatedBytes();
+        std::size_t size = serialize(books).size();
+        allocations = Bench::allocations() - allocations;
+        bytes = Bench::allocatedBytes() - bytes;
+
+        double nanos = Bench::nanosPerCall([serialize, &books]
+                                           {
+                                               if (serialize(books).empty())
+                                                   std::abort(); });
+        printf("%-16s %8.1f ns/row  %6.2f allocations/row  %7.1f heap bytes/row  %6.1f output bytes/row\n", label,
+               nanos / rows, static_cast<double>(allocations) / rows, static_cast<double>(bytes) / rows,
+               static_cast<double>(size) / rows);
+    }
+
+    void run()
+    {
+        std::vector<BookEntity> data = books();
+        printf("%zu books, scanning with the %s kernels\n", rows, TextScan::kernelName());
+        measure("per-row strings", perRowStrings, data);
+        measure("one buffer", oneBuffer, data);
+        measure("row by row", eachRow, data);
+    }
+
+    Bench::Registration registration("serializer", run);
+}
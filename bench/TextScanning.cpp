@@ -0,0 +1,125 @@
+#include "Bench.hpp"
+
+#include <Entity.hpp>
+#include <Field.hpp>
+#include <Json.hpp>
+#include <TextScan.hpp>
+
+#include <cstdlib>
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Each TextScan kernel set against the scalar one: the kernels alone over clean strings and runs of
+// white space of a few lengths, at the end of the text and followed by more, then parsing and serializing a pretty-printed array of books, whose
+// time is mostly string scanning.
+namespace
+{
+    using BookEntity = Entity<Field<"id", std::string>, Field<"author", std::string>, Field<"title", std::string>,
+                              Field<"genre", std::string>, Field<"publisher", std::string>>;
+
+    const char *volatile sink;
+
+    struct Case
+    {
+        std::string name;
+        std::function<void()> operation;
+    };
+
+    std::string books(std::size_t count)
+    {
+        std::string json = "[\n";
+        for (std::size_t i = 0; i < count; i++)
+        {
+            char id[40];
+            snprintf(id, sizeof(id), "0190f5a4-7c1e-7b3a-9d2e-%012zx", i);
+            json += i ? ",\n    {\n" : "    {\n";
+            json += "        \"id\": \"" + std::string(id) + "\",\n";
+            json += "        \"author\": \"Gabriel Garcia Marquez\",\n";
+            json += "        \"title\": \"One Hundred Years of Solitude, volume " + std::to_string(i) + "\",\n";
+            json += "        \"genre\": \"Magical Realism\",\n";
+            json += "        \"publisher\": \"Harper & Row, New York\"\n";
+            json += "    }";
+        }
+        json += "\n]\n";
+        return json;
+    }
+
+    std::vector<Case> cases()
+    {
+        std::vector<Case> cases;
+        for (std::size_t length : {16, 64, 1024})
+        {
+            auto text = std::make_shared<std::string>(length, 'a');
+            cases.push_back({"findEscape " + std::to_string(length) + " bytes", [text]
+                             { sink = TextScan::findEscape(text->data(), text->data() + text->size()); }});
+        }
+        for (std::size_t length : {1, 8, 64})
+        {
+            auto text = std::make_shared<std::string>(std::string(length, ' ') + "x");
+            cases.push_back({"skipWhitespace " + std::to_string(length) + " bytes", [text]
+                             { sink = TextScan::skipWhitespace(text->data(), text->data() + text->size()); }});
+        }
+        // Inside a document, where a run is followed by more text than it takes.
+        for (std::size_t length : {1, 8, 64})
+        {
+            auto text = std::make_shared<std::string>(std::string(length, ' ') + std::string(64, 'x'));
+            cases.push_back({"skipWhitespace " + std::to_string(length) + " + text", [text]
+                             { sink = TextScan::skipWhitespace(text->data(), text->data() + text->size()); }});
+        }
+
+        auto document = std::make_shared<std::string>(books(1000));
+        cases.push_back({"parse 1000 books", [document]
+                         {
+                             std::pmr::vector<std::optional<BookEntity>> parsed;
+                             if (!Json::parse(*document, parsed) || parsed.size() != 1000)
+                                 std::abort();
+                         }});
+        auto entities = std::make_shared<std::vector<BookEntity>>();
+        std::pmr::vector<std::optional<BookEntity>> parsed;
+        Json::parse(*document, parsed);
+        for (std::optional<BookEntity> &book : parsed)
+            entities->push_back(book.value());
+        cases.push_back({"serialize 1000 books", [entities]
+                         { sink = Json::toJson(*entities).data(); }});
+        return cases;
+    }
+
+    void run()
+    {
+        const char *selected = TextScan::kernelName();
+        std::vector<Case> all = cases();
+        std::vector<std::string> names;
+        std::vector<std::vector<double>> nanos(all.size());
+        for (const char *name : {"scalar", "sse2", "avx2"})
+        {
+            if (!TextScan::select(name))
+                continue;
+            names.push_back(name);
+            for (std::size_t i = 0; i < all.size(); i++)
+                nanos[i].push_back(Bench::nanosPerCall(all[i].operation));
+        }
+        TextScan::select(selected);
+
+        printf("%-28s", "ns per call (speedup)");
+        for (const std::string &name : names)
+            printf(" %18s", name.c_str());
+        printf("\n");
+        for (std::size_t i = 0; i < all.size(); i++)
+        {
+            printf("%-28s", all[i].name.c_str());
+            for (double value : nanos[i])
+            {
+                char cell[32];
+                snprintf(cell, sizeof(cell), "%.1f (%.2fx)", value, nanos[i][0] / value);
+                printf(" %18s", cell);
+            }
+            printf("\n");
+        }
+        printf("selected at startup: %s\n", selected);
+    }
+
+    Bench::Registration registration("textscan", run);
+}
@@ -0,0 +1,84 @@
+#include "Bench.hpp"
+
+#include <ThreadPool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Idle CPU of a parked pool and the time from addTask until a worker starts the task.
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Sample
+    {
+        Clock::time_point queued;
+        std::int64_t latency;
+    };
+
+    const char *modeName(PoolScheduling scheduling)
+    {
+        return scheduling == PoolScheduling::WorkStealing ? "work stealing" : "shared queue";
+    }
+
+    void idleCpu(PoolScheduling scheduling)
+    {
+        static constexpr int threads = 10;
+        ThreadPool<int> pool(threads, scheduling);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::chrono::nanoseconds before = Bench::processCpuTime();
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        std::chrono::nanoseconds used = Bench::processCpuTime() - before;
+        printf("%-14s idle CPU with %d workers: %.3f ms per second\n", modeName(scheduling), threads, used.count() / 1e6);
+    }
+
+    void dispatchLatency(PoolScheduling scheduling, bool burst)
+    {
+        static constexpr int threads = 4;
+        static constexpr std::size_t tasks = 20000;
+        std::vector<Sample> samples(tasks);
+        std::atomic<std::size_t> done(0);
+        ThreadPool<Sample *> pool(threads, scheduling);
+        ThreadPool<Sample *>::Work work = [&done](Sample *sample)
+        {
+            sample->latency = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sample->queued).count();
+            done.fetch_add(1, std::memory_order_release);
+        };
+
+        for (std::size_t i = 0; i < tasks; i++)
+        {
+            samples[i].queued = Clock::now();
+            pool.addTask(work, &samples[i]);
+            if (!burst)
+            {
+                // Let the task finish and the workers park again, so every task measures a wake-up.
+                while (done.load(std::memory_order_acquire) <= i)
+                    std::this_thread::yield();
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+        pool.drain();
+
+        std::vector<std::int64_t> latencies;
+        latencies.reserve(tasks);
+        for (const Sample &sample : samples)
+            latencies.push_back(sample.latency);
+        char label[64];
+        snprintf(label, sizeof(label), "%s, %s", modeName(scheduling), burst ? "burst" : "parked workers");
+        Bench::printPercentiles(label, latencies);
+    }
+
+    void run()
+    {
+        for (PoolScheduling scheduling : {PoolScheduling::SharedQueue, PoolScheduling::WorkStealing})
+        {
+            idleCpu(scheduling);
+            dispatchLatency(scheduling, false);
+            dispatchLatency(scheduling, true);
+        }
+    }
+
+    Bench::Registration registration("dispatch", run);
+}
@@ -0,0 +1,64 @@
+#include "Bench.hpp"
+
+#include <ThreadPool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Tasks per second through the shared queue and the work-stealing pool at 1 to 64 workers. Tasks
+// come from a few producer threads outside the pool, the way event loops feed it.
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int producers = 4;
+    static constexpr int tasksPerProducer = 100000;
+
+    // A little work per task, about what routing and parsing a small request costs.
+    void spin(int rounds)
+    {
+        volatile int sink = 0;
+        for (int i = 0; i < rounds; i++)
+            sink = sink + i;
+    }
+
+    double throughput(PoolScheduling scheduling, int threads, int rounds)
+    {
+        std::atomic<int> done(0);
+        ThreadPool<int> pool(threads, scheduling);
+        ThreadPool<int>::Work work = [&done](int rounds)
+        {
+            spin(rounds);
+            done.fetch_add(1, std::memory_order_relaxed);
+        };
+
+        Clock::time_point start = Clock::now();
+        std::vector<std::thread> feeders;
+        for (int p = 0; p < producers; p++)
+            feeders.emplace_back([&pool, &work, rounds]
+                                 {
+                                     for (int i = 0; i < tasksPerProducer; i++)
+                                         pool.addTask(work, rounds); });
+        for (std::thread &feeder : feeders)
+            feeder.join();
+        pool.drain();
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+        return producers * tasksPerProducer / elapsed.count();
+    }
+
+    void run()
+    {
+        for (int rounds : {0, 500})
+        {
+            printf("%d producers, %d spin rounds per task\n", producers, rounds);
+            printf("%8s %16s %16s\n", "workers", "shared queue/s", "stealing/s");
+            for (int threads : {1, 2, 4, 8, 16, 32, 64})
+                printf("%8d %16.0f %16.0f\n", threads, throughput(PoolScheduling::SharedQueue, threads, rounds),
+                       throughput(PoolScheduling::WorkStealing, threads, rounds));
+        }
+    }
+
+    Bench::Registration registration("throughput", run);
+}
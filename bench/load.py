@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Load generator for the REST server.
+
+Keeps a fixed number of connections busy for a fixed time and reports requests per second and
+latency percentiles. The connection mode selects how requests use the sockets:
+
+    close       a new connection per request, sent with "Connection: close"
+    keepalive   one request at a time on each persistent connection
+    pipeline    --depth requests written back to back on each connection before reading the replies
+
+Example, comparing connection reuse against a new handshake per request:
+
+    bench/load.py --mode close --connections 64 GET /books/fetchAll?limit=10
+    bench/load.py --mode keepalive --connections 64 GET /books/fetchAll?limit=10
+    bench/load.py --mode pipeline --depth 16 --connections 64 GET /books/fetchAll?limit=10
+"""
+
+import argparse
+import asyncio
+import time
+
+
+class Stats:
+    def __init__(self):
+        self.latencies = []
+        self.errors = 0
+        self.statuses = {}
+
+    def record(self, status, latency):
+        self.statuses[status] = self.statuses.get(status, 0) + 1
+        self.latencies.append(latency)
+
+
+async def read_response(reader):
+    """Reads one response, with a Content-Length or chunked body, and returns its status code."""
+    status_line = await reader.readline()
+    if not status_line:
+        raise ConnectionError("connection closed")
+    status = int(status_line.split()[1])
+    length = 0
+    chunked = False
+    while True:
+        line = await reader.readline()
+        if line in (b"\r\n", b""):
+            break
+        name, _, value = line.decode("latin-1").partition(":")
+        name = name.strip().lower()
+        if name == "content-length":
+            length = int(value)
+        elif name == "transfer-encoding" and "chunked" in value.lower():
+            chunked = True
+    if chunked:
+        while True:
+            size = int((await reader.readline()).split(b";")[0], 16)
+            await reader.readexactly(size + 2)
+            if size == 0:
+                break
+    elif length:
+        await reader.readexactly(length)
+    return status
+
+
+def build_request(args, keep_alive):
+    body = args.body.encode() if args.body else b""
+    head = f"{args.method} {args.path} HTTP/1.1\r\nHost: {args.host}\r\n"
+    head += "Connection: keep-alive\r\n" if keep_alive else "Connection: close\r\n"
+    if body:
+        head += f"Content-Type: application/json\r\nContent-Length: {len(body)}\r\n"
+    return head.encode() + b"\r\n" + body
+
+
+async def run_close(args, deadline, stats):
+    request = build_request(args, False)
+    while time.perf_counter() < deadline:
+        start = time.perf_counter()
+        try:
+            reader, writer = await asyncio.open_connection(args.host, args.port)
+            writer.write(request)
+            status = await read_response(reader)
+            writer.close()
+            stats.record(status, time.perf_counter() - start)
+        except (ConnectionError, OSError, asyncio.IncompleteReadError):
+            stats.errors += 1
+
+
+async def run_persistent(args, deadline, stats, depth):
+    request = build_request(args, True)
+    reader, writer = await asyncio.open_connection(args.host, args.port)
+    try:
+        while time.perf_counter() < deadline:
+            start = time.perf_counter()
+            writer.write(request * depth)
+            for _ in range(depth):
+                status = await read_response(reader)
+                stats.record(status, time.perf_counter() - start)
+    except (ConnectionError, OSError, asyncio.IncompleteReadError):
+        stats.errors += 1
+    finally:
+        writer.close()
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("method", choices=["GET", "POST"])
+    parser.add_argument("path")
+    parser.add_argument("--body", help="JSON body of a POST")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--mode", choices=["close", "keepalive", "pipeline"], default="keepalive")
+    parser.add_argument("--connections", type=int, default=32)
+    parser.add_argument("--depth", type=int, default=8, help="requests in flight per connection when pipelining")
+    parser.add_argument("--seconds", type=float, default=10)
+    args = parser.parse_args()
+
+    stats = Stats()
+    deadline = time.perf_counter() + args.seconds
+    if args.mode == "close":
+        workers = [run_close(args, deadline, stats) for _ in range(args.connections)]
+    else:
+        depth = args.depth if args.mode == "pipeline" else 1
+        workers = [run_persistent(args, deadline, stats, depth) for _ in range(args.connections)]
+    started = time.perf_counter()
+    await asyncio.gather(*workers)
+    elapsed = time.perf_counter() - started
+
+    latencies = sorted(stats.latencies)
+    count = len(latencies)
+    print(f"mode={args.mode} connections={args.connections} requests={count} errors={stats.errors} "
+          f"statuses={stats.statuses}")
+    print(f"requests/s: {count / elapsed:.0f}")
+    if count:
+        for percentile in (50, 90, 99):
+            print(f"p{percentile}: {latencies[min(count - 1, count * percentile // 100)] * 1000:.2f} ms")
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,155 @@
+#include "Bench.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <string_view>
+
+namespace
+{
+    std::atomic<std::uint64_t> allocationCount(0);
+    std::atomic<std::uint64_t> allocationBytes(0);
+
+    struct Entry
+    {
+        const char *name;
+        Bench::Run run;
+    };
+
+    // Filled by static registrations, so it must not depend on its own static initialization order.
+    std::vector<Entry> &entries()
+    {
+        static std::vector<Entry> list;
+        return list;
+    }
+
+    void *allocate(std::size_t size)
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(size, std::memory_order_relaxed);
+        if (void *block = std::malloc(size ? size : 1))
+            return block;
+        throw std::bad_alloc();
+    }
+
+    // std::pmr::new_delete_resource allocates through the aligned forms.
+    void *allocate(std::size_t size, std::align_val_t alignment)
+    {
+        std::size_t align = static_cast<std::size_t>(alignment);
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(size, std::memory_order_relaxed);
+        if (void *block = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align))
+            return block;
+        throw std::bad_alloc();
+    }
+}
+
+void *operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocate(size, alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return allocate(size, alignment);
+}
+
+void operator delete(void *block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete[](void *block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete(void *block, std::size_t) noexcept
+{
+    std::free(block);
+}
+
+void operator delete[](void *block, std::size_t) noexcept
+{
+    std::free(block);
+}
+
+void operator delete(void *block, std::align_val_t) noexcept
+{
+    std::free(block);
+}
+
+void operator delete[](void *block, std::align_val_t) noexcept
+{
+    std::free(block);
+}
+
+void operator delete(void *block, std::size_t, std::align_val_t) noexcept
+{
+    std::free(block);
+}
+
+void operator delete[](void *block, std::size_t, std::align_val_t) noexcept
+{
+    std::free(block);
+}
+
+Bench::Registration::Registration(const char *name, Run run)
+{
+    entries().push_back(Entry{name, run});
+}
+
+std::uint64_t Bench::allocations()
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Bench::allocatedBytes()
+{
+    return allocationBytes.load(std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds Bench::processCpuTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+}
+
+// bench [name...]: runs the named benchmarks, or all of them.
+int main(int argc, char **argv)
+{
+    bool ran = false;
+    for (const Entry &entry : entries())
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++)
+            selected = selected || std::string_view(argv[i]) == entry.name;
+        if (!selected)
+            continue;
+        printf("== %s\n", entry.name);
+        entry.run();
+        ran = true;
+    }
+    if (!ran)
+    {
+        printf("Benchmarks:");
+        for (const Entry &entry : entries())
+            printf(" %s", entry.name);
+        printf("\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#!/bin/sh
+# Latency of looking a book up by primary key with "id = ?" against the "id LIKE ?" filter it replaced,
+# on a table of $ROWS rows (default 1M) in a scratch schema that is dropped afterwards.
+#
+# Needs the mysql command line client. Connection options go in MYSQL_OPTS, for example
+#     MYSQL_OPTS="-h 127.0.0.1 -u root -psecret" bench/primary_key.sh
+set -eu
+
+ROWS=${ROWS:-1000000}
+RUNS=${RUNS:-2000}
+SCHEMA=${SCHEMA:-books_primary_key_bench}
+MYSQL_OPTS=${MYSQL_OPTS:-}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"; mysql $MYSQL_OPTS -e "DROP DATABASE IF EXISTS $SCHEMA"' EXIT
+
+sql() {
+    mysql $MYSQL_OPTS --batch --skip-column-names "$SCHEMA" "$@"
+}
+
+now() {
+    date +%s%N
+}
+
+mysql $MYSQL_OPTS -e "DROP DATABASE IF EXISTS $SCHEMA; CREATE DATABASE $SCHEMA"
+sql -e "CREATE TABLE book (id CHAR(36) PRIMARY KEY, author TEXT, title TEXT, genre TEXT, publisher TEXT)"
+
+echo "Seeding $ROWS rows..."
+sql -e "SET SESSION cte_max_recursion_depth = $ROWS;
+        INSERT INTO book (id, author, title, genre, publisher)
+        WITH RECURSIVE n (i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < $ROWS)
+        SELECT UUID(), CONCAT('Author ', i), CONCAT('Title ', i), 'Fiction', 'Publisher' FROM n;
+        ANALYZE TABLE book;" >/dev/null
+
+sql -e "SELECT id FROM book ORDER BY RAND() LIMIT $RUNS" >"$WORK/ids"
+
+for filter in "id = " "id LIKE "; do
+    sed "s/.*/SELECT * FROM book WHERE $filter'&';/" "$WORK/ids" >"$WORK/queries.sql"
+    echo "== WHERE ${filter}'<id>'"
+    # type, key and estimated rows of the plan.
+    sql -e "EXPLAIN SELECT * FROM book WHERE $filter'$(head -n 1 "$WORK/ids")'" | cut -f 5,7,10
+    start=$(now)
+    sql <"$WORK/queries.sql" >/dev/null
+    end=$(now)
+    echo "$RUNS lookups: $(((end - start) / RUNS / 1000)) us per lookup, client round trip included"
+done
+
+# A crafted id turns LIKE into a scan that matches every row.
+echo "== WHERE id LIKE '%'"
+start=$(now)
+sql -e "SELECT COUNT(*) FROM book WHERE id LIKE '%'"
+end=$(now)
+echo "$(((end - start) / 1000)) us"
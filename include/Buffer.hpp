@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Free lists of power-of-two blocks from 4 KiB to 1 MiB. Larger blocks go straight to the heap.
+// Not thread-safe: each event loop owns one, since only the loop reads into, grows and releases input
+// buffers; workers only consume requests from them, which never touches the pool.
+class BufferPool
+{
+private:
+    static constexpr std::size_t minBlockSize = 4096;
+    static constexpr std::size_t classCount = 9;
+    static constexpr std::size_t maxCachedPerClass = 64;
+
+    std::array<std::vector<std::unique_ptr<char[]>>, classCount> freeLists;
+
+    static std::size_t classIndex(std::size_t blockSize);
+
+public:
+    // Rounds size up to the block size that acquire will hand out.
+    static std::size_t blockSize(std::size_t size);
+
+    std::unique_ptr<char[]> acquire(std::size_t blockSize);
+    void release(std::unique_ptr<char[]> block, std::size_t blockSize);
+};
+
+// Contiguous, growable byte buffer whose storage comes from a BufferPool.
+class Buffer
+{
+private:
+    BufferPool *pool;
+    std::unique_ptr<char[]> block;
+    std::size_t capacity;
+    std::size_t begin;
+    std::size_t end;
+
+public:
+    explicit Buffer(BufferPool *pool) : pool(pool), capacity(0), begin(0), end(0) {}
+
+    ~Buffer()
+    {
+        release();
+    }
+
+    Buffer(const Buffer &) = delete;
+    Buffer(Buffer &&) = delete;
+    Buffer &operator=(const Buffer &) = delete;
+    Buffer &operator=(Buffer &&) = delete;
+
+    inline std::string_view view() const
+    {
+        return std::string_view(block.get() + begin, end - begin);
+    }
+
+    inline std::size_t size() const
+    {
+        return end - begin;
+    }
+
+    inline bool empty() const
+    {
+        return begin == end;
+    }
+
+    inline std::size_t writable() const
+    {
+        return capacity - end;
+    }
+
+    // Makes room for at least size more bytes and returns where they go.
+    char *reserve(std::size_t size);
+
+    inline void commit(std::size_t size)
+    {
+        end += size;
+    }
+
+    inline void consume(std::size_t size)
+    {
+        begin += size;
+        if (begin == end)
+            begin = end = 0;
+    }
+
+    // Hands the storage back to the pool; only valid while the buffer is empty.
+    void release();
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <string>
+
+#include <Buffer.hpp>
+#include <HttpParser.hpp>
+
+class EventLoop;
+
+struct Connection
+{
+    int fd;
+    EventLoop *loop;
+    Buffer input;
+    // Resumes across partial reads; reset once the worker has consumed the request.
+    HttpParser parser;
+    // Segments written with one sendmsg; outputOffset is how much of the front one has been sent.
+    std::deque<std::string> output;
+    std::size_t outputOffset = 0;
+    std::chrono::steady_clock::time_point lastActive = std::chrono::steady_clock::now();
+
+    // Owned by the event loop thread.
+    bool readClosed = false;
+    // Neighbours in the loop's list of connections by last activity; unlinked while busy.
+    Connection *idlePrevious = nullptr;
+    Connection *idleNext = nullptr;
+    bool broken = false;
+
+    // While busy the connection belongs to a worker; the loop does not touch
+    // input, output or closeAfterWrite until the worker hands it back.
+    bool busy = false;
+    bool closeAfterWrite = false;
+
+    Connection(int fd, EventLoop *loop, BufferPool *pool, std::size_t maxRequestSize)
+        : fd(fd), loop(loop), input(pool), parser(maxRequestSize) {}
+};
@@ -1,38 +1,155 @@
 #pragma once
 
 #include <mysqlx/xdevapi.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
 #include <optional>
+#include <set>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <vector>
 #include <type_traits>
-#include <uuid.h>
+#include <unordered_map>
 
 #include <Field.hpp>
 #include <Entity.hpp>
+
+// How id columns are stored: CHAR(36) text under the default case-insensitive, NO PAD collation, or
+// the 16 raw bytes in a BINARY(16) column. Entities always carry the text form; the conversion
+// happens when values are bound or read.
+enum class IdStorage
+{
+    Text,
+    Binary
+};
+
 class Database
 {
 private:
     mysqlx::Session session;
     mysqlx::Schema schema;
+    IdStorage idStorage;
+    std::chrono::steady_clock::time_point lastUsed;
+
+    // Table handles and statements built once per table for this session, keyed by the address of
+    // the TableName string. The X DevAPI prepares a statement on the server the second time the same
+    // object is executed, after which only new bindings are sent.
+    std::unordered_map<const char *, mysqlx::Table> tables;
+    std::unordered_map<const char *, mysqlx::TableSelect> selectAllStatements;
+    std::unordered_map<const char *, mysqlx::TableSelect> selectByIdStatements;
+    std::unordered_map<const char *, mysqlx::TableUpdate> updateStatements;
+    std::unordered_map<const char *, mysqlx::TableRemove> removeStatements;
+    // Keyset page selects by table and selected columns; the limit is set again on every run, which
+    // the X DevAPI sends as a parameter of the prepared statement rather than preparing it again.
+    std::map<std::pair<const char *, FieldMask>, mysqlx::TableSelect> pageStatements;
+
+    template <TableName T>
+    inline mysqlx::Table &table()
+    {
+        auto it = tables.find(T.string);
+        if (it == tables.end())
+            it = tables.emplace(T.string, schema.getTable(T.string)).first;
+        return it->second;
+    }
+
+    template <TableName T>
+    inline mysqlx::TableSelect &selectAllStatement()
+    {
+        auto it = selectAllStatements.find(T.string);
+        if (it == selectAllStatements.end())
+            it = selectAllStatements.emplace(T.string, table<T>().select()).first;
+        return it->second;
+    }
+
+    template <TableName T>
+    inline mysqlx::TableSelect &selectByIdStatement()
+    {
+        auto it = selectByIdStatements.find(T.string);
+        if (it == selectByIdStatements.end())
+        {
+            it = selectByIdStatements.emplace(T.string, table<T>().select()).first;
+            it->second.where("id = :uuid");
+        }
+        return it->second;
+    }
 
-    std::string generateUuid();
+    template <TableName T, FieldConcept... Fields>
+    inline mysqlx::TableUpdate &updateStatement()
+    {
+        auto it = updateStatements.find(T.string);
+        if (it == updateStatements.end())
+        {
+            it = updateStatements.emplace(T.string, mysqlx::TableUpdate(table<T>(), "id = :uuid")).first;
+            PrepareUpdate<sizeof...(Fields) - 1, Fields...>{}(it->second);
+        }
+        return it->second;
+    }
+
+    template <TableName T, FieldConcept... Fields>
+    inline mysqlx::TableSelect &pageStatement(FieldMask fields)
+    {
+        auto key = std::make_pair(T.string, fields);
+        auto it = pageStatements.find(key);
+        if (it == pageStatements.end())
+        {
+            it = pageStatements.emplace(key, table<T>().select(selectedColumns<Fields...>(fields))).first;
+            it->second.where("id > :after").orderBy("id");
+        }
+        return it->second;
+    }
+
+    template <TableName T>
+    inline mysqlx::TableRemove &removeStatement()
+    {
+        auto it = removeStatements.find(T.string);
+        if (it == removeStatements.end())
+            it = removeStatements.emplace(T.string, mysqlx::TableRemove(table<T>(), "id = :uuid")).first;
+        return it->second;
+    }
+
+    // Time-ordered UUIDv7, so new rows land at the end of the primary key index.
+    static std::string generateUuid();
+
+    // The value to bind for an id in the configured storage. Ids that are not valid UUIDs bind as
+    // empty bytes in binary storage and match no row.
+    mysqlx::Value idValue(const std::string &id) const;
+
+    // Text form of an id column, whichever way it is stored.
+    static std::string readId(const mysqlx::Value &value);
 
     template <std::size_t i, FieldConcept... Fields>
-    struct GetTableUpdate
+    inline mysqlx::Value columnValue(const Entity<Fields...> &entity) const
     {
-        mysqlx::TableUpdate operator()(mysqlx::Table &t, const Entity<Fields...> &entity)
+        if constexpr (i == 0)
+            return idValue(getField<0, Fields...>(entity).value);
+        else
+            return getField<i, Fields...>(entity).value;
+    }
+
+    // Every column but the id is set from a placeholder named after the column.
+    template <std::size_t i, FieldConcept... Fields>
+    struct PrepareUpdate
+    {
+        void operator()(mysqlx::TableUpdate &update)
         {
-            return GetTableUpdate<i - 1, Fields...>{}(t, entity).set(getField<i, Fields...>(entity).columnName.string,
-                                                                     getField<i, Fields...>(entity).value);
+            if constexpr (i > 1)
+                PrepareUpdate<i - 1, Fields...>{}(update);
+            const char *column = GetColumnName<i, Fields...>::name.string;
+            update.set(column, mysqlx::expr(std::string(":") + column));
         }
     };
 
-    template <FieldConcept... Fields>
-    struct GetTableUpdate<0, Fields...>
+    template <std::size_t i, FieldConcept... Fields>
+    struct BindUpdate
     {
-        mysqlx::TableUpdate operator()(mysqlx::Table &t, const Entity<Fields...> &entity)
+        void operator()(mysqlx::TableUpdate &update, const Entity<Fields...> &entity)
         {
-            return t.update();
+            if constexpr (i > 1)
+                BindUpdate<i - 1, Fields...>{}(update, entity);
+            update.bind(getField<i, Fields...>(entity).columnName.string, getField<i, Fields...>(entity).value);
         }
     };
 
@@ -55,59 +172,169 @@ private:
 
         void operator()(const mysqlx::Row &row, Entity<Fields...> &entity)
         {
-            getField<0, Fields...>(entity).value = FieldValueType(row[0]);
+            getField<0, Fields...>(entity).value = readId(row[0]);
         }
     };
 
-    template <TableName T, FieldConcept... Fields, std::size_t... I>
-    inline int createImpl(Entity<Fields...> &entity, std::index_sequence<I...>)
+    template <std::size_t i, FieldConcept... Fields>
+    struct FillSelectedEntity
+    {
+        using FieldValueType = GetFieldType<i, Fields...>::type;
+
+        void operator()(const mysqlx::Row &row, Entity<Fields...> &entity, FieldMask fields, mysqlx::col_count_t &column)
+        {
+            if constexpr (i > 0)
+                FillSelectedEntity<i - 1, Fields...>{}(row, entity, fields, column);
+            if (!(fields & (FieldMask(1) << i)))
+                return;
+            if constexpr (i == 0)
+                getField<0, Fields...>(entity).value = readId(row[column++]);
+            else
+                getField<i, Fields...>(entity).value = FieldValueType(row[column++]);
+        }
+    };
+
+    template <FieldConcept... Fields>
+    static std::vector<std::string> selectedColumns(FieldMask fields)
+    {
+        std::vector<std::string> columns;
+        FieldMask bit = 1;
+        for (const char *column : {static_cast<const char *>(Fields::columnName.string)...})
+        {
+            if (fields & bit)
+                columns.push_back(column);
+            bit <<= 1;
+        }
+        return columns;
+    }
+
+    template <FieldConcept... Fields>
+    inline void assignId(Entity<Fields...> &entity)
     {
         std::string uuid = generateUuid();
         getField<0>(entity) = Field<GetColumnName<0, Fields...>::name.string, typename GetFieldType<0, Fields...>::type>(uuid);
-        mysqlx::Table t = schema.getTable(T.string);
+    }
+
+    template <TableName T, FieldConcept... Fields, std::size_t... I>
+    inline int createImpl(Entity<Fields...> &entity, std::index_sequence<I...>)
+    {
+        assignId(entity);
+        mysqlx::Table &t = table<T>();
         mysqlx::Result res = t.insert(Fields::columnName.string...)
-                                 .values(getField<I, Fields...>(entity).value...)
+                                 .values(columnValue<I, Fields...>(entity)...)
                                  .execute();
+        tableVersion<T>().fetch_add(1);
         return res.getAffectedItemsCount();
     }
 
+    template <TableName T, FieldConcept... Fields, std::size_t... I>
+    inline int createBatchImpl(std::vector<Entity<Fields...>> &entities, std::index_sequence<I...>)
+    {
+        static constexpr std::size_t rowsPerStatement = 1000;
+
+        mysqlx::Table &t = table<T>();
+        int rows = 0;
+        session.startTransaction();
+        try
+        {
+            for (std::size_t first = 0; first < entities.size(); first += rowsPerStatement)
+            {
+                mysqlx::TableInsert insert = t.insert(Fields::columnName.string...);
+                std::size_t last = std::min(entities.size(), first + rowsPerStatement);
+                for (std::size_t j = first; j < last; j++)
+                {
+                    assignId(entities[j]);
+                    insert.values(columnValue<I, Fields...>(entities[j])...);
+                }
+                rows += insert.execute().getAffectedItemsCount();
+            }
+            session.commit();
+        }
+        catch (const mysqlx::Error &)
+        {
+            session.rollback();
+            return 0;
+        }
+        tableVersion<T>().fetch_add(1);
+        return rows;
+    }
+
 public:
-    Database();
+    class Pipeline;
+
+    explicit Database(mysqlx::Session &&session, IdStorage idStorage = IdStorage::Text);
     ~Database();
 
+    Database(const Database &) = delete;
+    Database(Database &&) = delete;
+    Database &operator=(const Database &) = delete;
+    Database &operator=(Database &&) = delete;
+
+    bool healthy();
+
+    // The form two ids take when this database's id column treats them as the same key, for keying
+    // caches: the UUID they parse to in binary storage, and lower case in text storage.
+    std::string idKey(std::string_view id) const;
+
+    // Bumped after every committed write to table T through any Database, so a cached read of T
+    // taken at an older version is known to be stale.
+    template <TableName T>
+    static inline std::atomic<std::uint64_t> &tableVersion()
+    {
+        static std::atomic<std::uint64_t> version(0);
+        return version;
+    }
+
+    inline void touch()
+    {
+        lastUsed = std::chrono::steady_clock::now();
+    }
+
+    inline std::chrono::steady_clock::duration idleFor() const
+    {
+        return std::chrono::steady_clock::now() - lastUsed;
+    }
+
     template <TableName T, FieldConcept... Fields, typename Indices = std::make_index_sequence<sizeof...(Fields)>>
     inline int create(Entity<Fields...> &entity)
     {
         return createImpl<T>(entity, Indices{});
     }
 
+    // Inserts all entities in one transaction with multi-row inserts; returns 0 if the transaction was rolled back.
+    template <TableName T, FieldConcept... Fields, typename Indices = std::make_index_sequence<sizeof...(Fields)>>
+    inline int createBatch(std::vector<Entity<Fields...>> &entities)
+    {
+        if (entities.empty())
+            return 0;
+        return createBatchImpl<T>(entities, Indices{});
+    }
+
     template <TableName T, FieldConcept... Fields>
     inline int update(const Entity<Fields...> &entity)
     {
-        mysqlx::Table t = schema.getTable(T.string);
-        mysqlx::Result res = GetTableUpdate<sizeof...(Fields) - 1, Fields...>{}(t, entity)
-                                 .where("id LIKE :uuid")
-                                 .bind("uuid", getField<0>(entity).value)
-                                 .execute();
+        mysqlx::TableUpdate &update = updateStatement<T, Fields...>();
+        BindUpdate<sizeof...(Fields) - 1, Fields...>{}(update, entity);
+        update.bind("uuid", idValue(getField<0>(entity).value));
+        mysqlx::Result res = update.execute();
+        tableVersion<T>().fetch_add(1);
         return res.getAffectedItemsCount();
     }
 
     template <TableName T>
     inline int remove(const std::string &id)
     {
-        mysqlx::Table t = schema.getTable(T.string);
-        mysqlx::Result res = t.remove()
-                                 .where("id LIKE :uuid")
-                                 .bind("uuid", id)
-                                 .execute();
+        mysqlx::TableRemove &remove = removeStatement<T>();
+        remove.bind("uuid", idValue(id));
+        mysqlx::Result res = remove.execute();
+        tableVersion<T>().fetch_add(1);
         return res.getAffectedItemsCount();
     }
 
     template <TableName T, FieldConcept... Fields>
     inline void fetchAll(std::vector<Entity<Fields...>> &entities)
     {
-        mysqlx::Table t = schema.getTable(T.string);
-        mysqlx::RowResult result = t.select().execute();
+        mysqlx::RowResult result = selectAllStatement<T>().execute();
         for (const auto &row : result)
         {
             Entity<Fields...> entity;
@@ -116,14 +343,47 @@ public:
         }
     }
 
+    // Keyset page: up to limit rows with id greater than afterId, in id order, reading only the selected columns.
+    template <TableName T, FieldConcept... Fields>
+    inline void fetchPage(std::vector<Entity<Fields...>> &entities, FieldMask fields, const std::string &afterId,
+                          unsigned int limit)
+    {
+        // Bits past the last column select nothing, so they do not make a statement of their own.
+        fields &= (FieldMask(1) << sizeof...(Fields)) - 1;
+        mysqlx::TableSelect &select = pageStatement<T, Fields...>(fields);
+        select.limit(limit);
+        select.bind("after", idValue(afterId));
+        mysqlx::RowResult result = select.execute();
+        entities.reserve(result.count());
+        for (const auto &row : result)
+        {
+            Entity<Fields...> entity;
+            mysqlx::col_count_t column = 0;
+            FillSelectedEntity<sizeof...(Fields) - 1, Fields...>{}(row, entity, fields, column);
+            entities.push_back(std::move(entity));
+        }
+    }
+
+    // Fills entity from one row at a time and hands it to consumer until it returns false.
+    template <TableName T, FieldConcept... Fields, typename Consumer>
+    inline void fetchEach(Entity<Fields...> &entity, Consumer &&consumer)
+    {
+        mysqlx::RowResult result = selectAllStatement<T>().execute();
+        mysqlx::Row row;
+        while ((row = result.fetchOne()))
+        {
+            FillEntity<sizeof...(Fields) - 1, Fields...>{}(row, entity);
+            if (!consumer(static_cast<const Entity<Fields...> &>(entity)))
+                break;
+        }
+    }
+
     template <TableName T, FieldConcept... Fields>
     inline void fetchById(const std::string &id, std::optional<Entity<Fields...>> &entityOptional)
     {
-        mysqlx::Table t = schema.getTable(T.string);
-        mysqlx::RowResult result = t.select()
-                                       .where("id LIKE :uuid")
-                                       .bind("uuid", id)
-                                       .execute();
+        mysqlx::TableSelect &select = selectByIdStatement<T>();
+        select.bind("uuid", idValue(id));
+        mysqlx::RowResult result = select.execute();
         if (!result.count())
         {
             entityOptional = {};
@@ -136,6 +396,81 @@ public:
     }
 };
 
+// Collects update and remove operations and runs them in one transaction on one session, with the
+// updates to each table merged into one insert of the rows that already exist and the removes from
+// each table merged into one delete.
+class Database::Pipeline
+{
+private:
+    struct Operation
+    {
+        std::size_t slot;
+        std::string id;
+    };
+
+    struct Updates
+    {
+        std::vector<std::string> columns;
+        std::vector<Operation> entries;
+        // The values of each entry's columns, one entry after another.
+        std::vector<mysqlx::Value> values;
+    };
+
+    Database &database;
+    std::size_t operations = 0;
+    std::map<std::string, Updates> updates;
+    std::map<std::string, std::vector<Operation>> removals;
+    // Versions of every table written to, bumped once the transaction has ended.
+    std::vector<std::atomic<std::uint64_t> *> versions;
+
+    template <FieldConcept... Fields, std::size_t... I>
+    inline void appendValues(std::vector<mysqlx::Value> &values, const Entity<Fields...> &entity,
+                             std::index_sequence<I...>)
+    {
+        (values.push_back(database.columnValue<I, Fields...>(entity)), ...);
+    }
+
+    std::set<std::string> lockExisting(mysqlx::Table &table, const std::vector<Operation> &entries);
+    std::string upsertQuery(const std::string &table, const std::vector<std::string> &columns, std::size_t rows);
+    void updateAll(const std::string &table, const Updates &entries, std::vector<int> &results);
+    void removeAll(const std::string &table, const std::vector<Operation> &entries, std::vector<int> &results);
+    void bumpVersions();
+
+public:
+    explicit Pipeline(Database &database) : database(database) {}
+
+    Pipeline(const Pipeline &) = delete;
+    Pipeline(Pipeline &&) = delete;
+    Pipeline &operator=(const Pipeline &) = delete;
+    Pipeline &operator=(Pipeline &&) = delete;
+
+    // Queues an update of an existing row and returns the index of its result.
+    template <TableName T, FieldConcept... Fields>
+    inline std::size_t update(const Entity<Fields...> &entity)
+    {
+        Updates &table = updates[T.string];
+        if (table.columns.empty())
+            table.columns = {Fields::columnName.string...};
+        table.entries.push_back(Operation{operations, getField<0>(entity).value});
+        appendValues(table.values, entity, std::make_index_sequence<sizeof...(Fields)>{});
+        versions.push_back(&tableVersion<T>());
+        return operations++;
+    }
+
+    // Queues a remove and returns the index of its result.
+    template <TableName T>
+    inline std::size_t remove(const std::string &id)
+    {
+        removals[T.string].push_back(Operation{operations, id});
+        versions.push_back(&tableVersion<T>());
+        return operations++;
+    }
+
+    // Commits every queued operation or none. Returns the rows each operation hit, in the order they
+    // were queued, or nothing if the transaction was rolled back.
+    std::optional<std::vector<int>> execute();
+};
+
 namespace Entities
 {
     namespace Book
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <mysqlx/xdevapi.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include <Database.hpp>
+#include <Log.hpp>
+
+class DatabasePool
+{
+public:
+    // Exclusive use of one pooled Database; hands it back to the pool on destruction.
+    class Lease
+    {
+    private:
+        DatabasePool *pool;
+        std::unique_ptr<Database> database;
+
+    public:
+        Lease(DatabasePool *pool, std::unique_ptr<Database> database) : pool(pool), database(std::move(database)) {}
+        Lease(Lease &&other) = default;
+
+        ~Lease()
+        {
+            if (database)
+                pool->release(std::move(database));
+        }
+
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        Lease &operator=(Lease &&) = delete;
+
+        inline Database &operator*()
+        {
+            return *database;
+        }
+
+        inline Database *operator->()
+        {
+            return database.get();
+        }
+    };
+
+private:
+    std::size_t minSize;
+    std::size_t maxSize;
+    std::chrono::milliseconds leaseTimeout;
+    std::chrono::milliseconds healthCheckInterval;
+    IdStorage idStorage;
+    mysqlx::Client client;
+    std::mutex mutex;
+    std::condition_variable available;
+    std::vector<std::unique_ptr<Database>> idle;
+    std::size_t total;
+
+    std::unique_ptr<Database> open();
+    void release(std::unique_ptr<Database> database);
+
+public:
+    explicit DatabasePool(std::size_t minSize = 1, std::size_t maxSize = 10,
+                          std::chrono::milliseconds leaseTimeout = std::chrono::seconds(5),
+                          std::chrono::milliseconds healthCheckInterval = std::chrono::seconds(30),
+                          IdStorage idStorage = IdStorage::Text);
+
+    ~DatabasePool();
+
+    DatabasePool(const DatabasePool &) = delete;
+    DatabasePool(DatabasePool &&) = delete;
+    DatabasePool &operator=(const DatabasePool &) = delete;
+    DatabasePool &operator=(DatabasePool &&) = delete;
+
+    // Returns an empty optional when no session became available within the lease timeout.
+    std::optional<Lease> lease();
+};
+
+template <>
+struct ClassName<DatabasePool>
+{
+    static constexpr const char *name = "DatabasePool";
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <string_view>
 #include <type_traits>
 
 #include <Field.hpp>
@@ -16,6 +18,11 @@ struct GetType<0, T, Types...>
     using type = T;
 };
 
+// One bit per entity field, in declaration order.
+using FieldMask = std::uint64_t;
+
+static inline constexpr FieldMask allFields = ~FieldMask(0);
+
 template <std::size_t i, FieldConcept F>
 class EntityFieldNode
 {
@@ -72,6 +79,20 @@ public:
     {
         return sizeof...(Fields) + 1;
     }
+
+    // Bit of the field whose column is named column, or 0 if there is none.
+    static inline FieldMask columnMask(std::string_view column)
+    {
+        FieldMask mask = 0;
+        FieldMask bit = 1;
+        for (std::string_view name : {std::string_view(F::columnName.string), std::string_view(Fields::columnName.string)...})
+        {
+            if (name == column)
+                mask |= bit;
+            bit <<= 1;
+        }
+        return mask;
+    }
 };
 
 template <std::size_t i, FieldConcept F, FieldConcept... Fields>
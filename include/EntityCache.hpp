@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Read-through cache of serialized entities keyed by (table, id). It is split into shards, each with
+// its own lock and least recently used list, and each shard holds at most its share of the byte capacity.
+class EntityCache
+{
+public:
+    struct Statistics
+    {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::size_t entries = 0;
+        std::size_t bytes = 0;
+    };
+
+private:
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<std::pair<std::string, std::string>> entries;
+        std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator> index;
+        std::size_t bytes = 0;
+        // Bumped by every invalidation, so a value read before a write is never stored after it.
+        std::uint64_t version = 0;
+    };
+
+    std::size_t shardCapacity;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<std::uint64_t> hits;
+    std::atomic<std::uint64_t> misses;
+
+    static std::string key(const char *table, const std::string &id);
+    Shard &shardFor(const std::string &key);
+    void evict(Shard &shard, std::list<std::pair<std::string, std::string>>::iterator entry);
+
+public:
+    explicit EntityCache(std::size_t capacity = 64 * 1024 * 1024, std::size_t shardCount = 16);
+
+    EntityCache(const EntityCache &) = delete;
+    EntityCache(EntityCache &&) = delete;
+    EntityCache &operator=(const EntityCache &) = delete;
+    EntityCache &operator=(EntityCache &&) = delete;
+
+    std::optional<std::string> find(const char *table, const std::string &id);
+
+    // Take the version before reading the database and hand it to store with the result.
+    std::uint64_t version(const char *table, const std::string &id);
+    void store(const char *table, const std::string &id, std::string json, std::uint64_t version);
+
+    void invalidate(const char *table, const std::string &id);
+
+    Statistics statistics();
+};
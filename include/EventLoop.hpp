@@ -0,0 +1,87 @@
+#pragma once
+
+#include <sys/epoll.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <Buffer.hpp>
+#include <Connection.hpp>
+#include <Log.hpp>
+
+class EventLoop
+{
+public:
+    // Called on the loop thread whenever an idle connection may hold a new request. Returns false when
+    // more input is needed; otherwise the connection has been marked busy.
+    using RequestCallback = std::function<bool(Connection &)>;
+    // Called on the loop thread once per batch of events with the connections that became busy in it.
+    using DispatchCallback = std::function<void(const std::vector<Connection *> &)>;
+
+private:
+    static constexpr int maxEvents = 64;
+    static constexpr int listenBacklog = 1024;
+    static constexpr std::size_t maxIovecs = 64;
+
+    int port;
+    std::chrono::milliseconds idleTimeout;
+    std::size_t maxRequestSize;
+    int epollFd;
+    int listenFd;
+    int wakeFd;
+    std::atomic<bool> running;
+    std::thread thread;
+    RequestCallback onRequest;
+    DispatchCallback onDispatch;
+    std::vector<Connection *> dispatched;
+    // Declared before connections so that their buffers can return storage on destruction.
+    BufferPool bufferPool;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::vector<std::unique_ptr<Connection>> closed;
+    // Connections that are not busy, least recently active first, so the sweep only visits expired ones.
+    Connection *idleFirst;
+    Connection *idleLast;
+    std::mutex completedMutex;
+    std::vector<Connection *> completed;
+
+    bool createListener();
+    void run();
+    void acceptClients();
+    void drainCompleted();
+    void closeIdle();
+    void touch(Connection &connection);
+    void unlink(Connection &connection);
+    void service(Connection &connection);
+    void readInput(Connection &connection);
+    bool writeOutput(Connection &connection);
+    void closeConnection(Connection &connection);
+
+public:
+    EventLoop(int port, std::chrono::milliseconds idleTimeout, std::size_t maxRequestSize, const RequestCallback &onRequest,
+              const DispatchCallback &onDispatch);
+
+    ~EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop(EventLoop &&) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+    EventLoop &operator=(EventLoop &&) = delete;
+
+    bool start();
+    void stop();
+
+    // Hands a busy connection back to the loop; safe to call from any thread.
+    void resume(Connection *connection);
+};
+
+template <>
+struct ClassName<EventLoop>
+{
+    static constexpr const char *name = "EventLoop";
+};
@@ -75,7 +75,8 @@ struct Field : public FieldBase
     Field() : value() {}
     Field(const FieldType &value) : value(value) {}
     Field(const Field &field) : value(field.value) {}
-    Field(Field &&field) : value(std::move(field.value)) {}
+    // noexcept so that containers of entities move them when they grow instead of copying.
+    Field(Field &&field) noexcept(std::is_nothrow_move_constructible_v<FieldType>) : value(std::move(field.value)) {}
 
     inline Field &operator=(const Field &other)
     {
@@ -83,7 +84,7 @@ struct Field : public FieldBase
         return *this;
     }
 
-    inline Field &operator=(Field &&other)
+    inline Field &operator=(Field &&other) noexcept(std::is_nothrow_move_assignable_v<FieldType>)
     {
         value = std::move(other.value);
         return *this;
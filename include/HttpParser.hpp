@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Incremental HTTP/1.1 request parser. It keeps only offsets into the receive buffer, so parsing
+// can resume after the buffer grows, and it allocates nothing per header.
+class HttpParser
+{
+public:
+    enum class State
+    {
+        RequestLine,
+        Headers,
+        Body,
+        Complete,
+        Error,
+        TooLarge
+    };
+
+    // Views into the buffer passed to the parse call that completed the request.
+    struct Message
+    {
+        std::string_view method;
+        std::string_view target;
+        std::string_view body;
+        bool json = false;
+        bool keepAlive = true;
+        // Bytes of the buffer taken up by this request.
+        std::size_t length = 0;
+    };
+
+private:
+    struct Span
+    {
+        std::size_t offset = 0;
+        std::size_t length = 0;
+
+        inline std::string_view in(std::string_view buffer) const
+        {
+            return buffer.substr(offset, length);
+        }
+    };
+
+    static constexpr std::size_t maxLineLength = 8192;
+
+    std::size_t maxLength;
+    State state = State::RequestLine;
+    std::size_t lineStart = 0;
+    std::size_t scanned = 0;
+    Span method;
+    Span target;
+    std::size_t bodyStart = 0;
+    std::size_t contentLength = 0;
+    bool json = false;
+    bool keepAlive = true;
+    Message message;
+
+    static bool equalsIgnoreCase(std::string_view a, std::string_view b);
+    static std::string_view trim(std::string_view value);
+
+    bool parseRequestLine(std::string_view line);
+    bool parseHeader(std::string_view line);
+
+public:
+    // Requests longer than maxLength bytes, headers included, end in State::TooLarge.
+    explicit HttpParser(std::size_t maxLength) : maxLength(maxLength) {}
+
+    // Continues from where the previous call stopped; buffer must hold the same bytes as before plus any new ones.
+    State parse(std::string_view buffer);
+
+    void reset();
+
+    inline State getState() const
+    {
+        return state;
+    }
+
+    inline const Message &getMessage() const
+    {
+        return message;
+    }
+};
@@ -1,189 +1,638 @@
 #pragma once
 
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory_resource>
 #include <optional>
+// Before rapidjson, which picks up its scanning hook from it.
+#include <TextScan.hpp>
 #include <rapidjson/document.h>
-#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/encodedstream.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
 #include <rapidjson/writer.h>
-#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <Field.hpp>
 #include <Entity.hpp>
+#include <EntityCache.hpp>
 
 class Json
 {
 private:
+    // rapidjson output stream that appends to a std::string, so a response is serialized straight into
+    // the buffer that is later handed to the connection.
+    class StringOutput
+    {
+    private:
+        std::string &output;
+
+    public:
+        using Ch = char;
+
+        explicit StringOutput(std::string &output) : output(output) {}
+
+        inline void Put(char c)
+        {
+            output.push_back(c);
+        }
+
+        inline void Flush() {}
+    };
+
+    using Writer = rapidjson::Writer<StringOutput>;
+
+    // rapidjson allocator over a memory resource, meant for a request arena that frees everything at once:
+    // blocks are never freed individually and growing one copies it into a new block.
+    class ResourceAllocator
+    {
+    private:
+        std::pmr::memory_resource *resource;
+
+    public:
+        static const bool kNeedFree = false;
+
+        ResourceAllocator() : resource(std::pmr::get_default_resource()) {}
+        explicit ResourceAllocator(std::pmr::memory_resource *resource) : resource(resource) {}
+
+        inline void *Malloc(std::size_t size)
+        {
+            return size ? resource->allocate(size, alignof(std::max_align_t)) : nullptr;
+        }
+
+        inline void *Realloc(void *original, std::size_t originalSize, std::size_t newSize)
+        {
+            if (newSize <= originalSize)
+                return original;
+            void *block = Malloc(newSize);
+            if (original)
+                std::memcpy(block, original, originalSize);
+            return block;
+        }
+
+        static inline void Free(void *) {}
+    };
+
+    using ArenaReader = rapidjson::GenericReader<rapidjson::UTF8<>, rapidjson::UTF8<>, ResourceAllocator>;
+
+    // Rough size of one serialized field, used to reserve the output of a list up front.
+    static constexpr std::size_t estimatedFieldSize = 24;
+
+    static void appendString(std::string &json, std::string_view value);
+    static void appendNumber(std::string &json, int value);
+    static void appendNumber(std::string &json, unsigned int value);
+    static void appendNumber(std::string &json, double value);
+
+    // The fragment ,"column": of field i, built at compile time; the comma is left off for the first member.
+    template <std::size_t i, FieldConcept... Fields>
+    struct FieldKey
+    {
+        static constexpr auto name = GetColumnName<i, Fields...>::name;
+        static constexpr std::size_t length = name.size() + 4;
+
+        static constexpr std::array<char, length> text = []() consteval
+        {
+            std::array<char, length> text{};
+            text[0] = ',';
+            text[1] = '"';
+            for (std::size_t j = 0; j < name.size(); j++)
+                text[j + 2] = name.string[j];
+            text[length - 2] = '"';
+            text[length - 1] = ':';
+            return text;
+        }();
+    };
+
+    // Appends the selected fields as members; only the values are formatted at run time.
     template <std::size_t i, FieldConcept... Fields>
     struct ToJson
     {
         using FieldValueType = GetFieldType<i, Fields...>::type;
 
-        void operator()(rapidjson::Writer<rapidjson::OStreamWrapper> &writer, const Entity<Fields...> &entity)
+        void operator()(std::string &json, const Entity<Fields...> &entity, FieldMask fields, bool &first)
         {
-            ToJson<i - 1, Fields...>{}(writer, entity);
-            writer.Key(getField<i, Fields...>(entity).columnName.string);
+            if constexpr (i > 0)
+                ToJson<i - 1, Fields...>{}(json, entity, fields, first);
+            if (!(fields & (FieldMask(1) << i)))
+                return;
+            using Key = FieldKey<i, Fields...>;
+            json.append(Key::text.data() + first, Key::length - first);
+            first = false;
             if constexpr (std::is_same_v<std::string, FieldValueType>)
-                writer.String(getField<i, Fields...>(entity).value.c_str(), getField<i, Fields...>(entity).value.size());
-            else if (std::is_same_v<int, FieldValueType>)
-                writer.Int(getField<i, Fields...>(entity).value);
+                appendString(json, getField<i, Fields...>(entity).value);
             else
-                writer.Double(getField<i, Fields...>(entity).value);
+                appendNumber(json, getField<i, Fields...>(entity).value);
         }
     };
 
+    // SAX handler that fills entities straight from rapidjson::Reader events. Keys are matched against the
+    // column names of the entity type; members with other names are skipped. An entity is only produced
+    // if every field was present with the right type. In array mode it reads an array of entities and
+    // leaves an empty slot for every element that is not a valid entity.
     template <FieldConcept... Fields>
-    struct ToJson<0, Fields...>
+    class EntityReader : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, EntityReader<Fields...>>
     {
-        using FieldValueType = GetFieldType<0, Fields...>::type;
+    private:
+        using EntityType = Entity<Fields...>;
+
+        static constexpr FieldMask requiredFields = sizeof...(Fields) >= 64 ? allFields : (FieldMask(1) << sizeof...(Fields)) - 1;
 
-        void operator()(rapidjson::Writer<rapidjson::OStreamWrapper> &writer, const Entity<Fields...> &entity)
+        std::optional<EntityType> *single;
+        std::pmr::vector<std::optional<EntityType>> *entities;
+        // Depth at which the members of an entity appear: 1 for a single object, 2 inside an array.
+        std::size_t memberDepth;
+        std::size_t depth = 0;
+        int field = -1;
+        FieldMask seen = 0;
+        bool inEntity = false;
+        bool valid = false;
+        EntityType entity;
+
+        template <std::size_t... I>
+        static inline int fieldIndex(std::string_view key, std::index_sequence<I...>)
         {
-            writer.Key(getField<0, Fields...>(entity).columnName.string);
-            if constexpr (std::is_same_v<std::string, FieldValueType>)
-                writer.String(getField<0, Fields...>(entity).value.c_str(), getField<0, Fields...>(entity).value.size());
-            else if (std::is_same_v<int, FieldValueType>)
-                writer.Int(getField<0, Fields...>(entity).value);
+            int index = -1;
+            ((key == std::string_view(GetColumnName<I, Fields...>::name.string) ? (index = I, true) : false) || ...);
+            return index;
+        }
+
+        template <std::size_t i, typename V>
+        inline bool assign(V &&value)
+        {
+            using FieldValueType = GetFieldType<i, Fields...>::type;
+            if constexpr (std::is_same_v<std::string, FieldValueType> && std::is_same_v<std::string_view, std::decay_t<V>>)
+                getField<i, Fields...>(entity).value.assign(value.data(), value.size());
+            else if constexpr (std::is_same_v<FieldValueType, std::decay_t<V>>)
+                getField<i, Fields...>(entity).value = value;
             else
-                writer.Double(getField<0, Fields...>(entity).value);
+                return false;
+            return true;
         }
-    };
 
-    template <std::size_t i, FieldConcept... Fields>
-    struct ParseJson
-    {
-        using FieldValueType = GetFieldType<i, Fields...>::type;
+        template <typename V, std::size_t... I>
+        inline bool assignField(V &&value, std::index_sequence<I...>)
+        {
+            bool assigned = false;
+            ((field == static_cast<int>(I) ? (assigned = assign<I>(std::forward<V>(value)), true) : false) || ...);
+            return assigned;
+        }
 
-        bool operator()(const rapidjson::Document &doc, Entity<Fields...> &entity)
+        // A value that opens no object or array.
+        template <typename V>
+        inline bool scalar(V &&value)
         {
-            bool ok = ParseJson<i - 1, Fields...>{}(doc, entity);
-            if (ok)
+            if (!depth)
+                return single != nullptr;
+            if (entities && depth == 1)
+                entities->emplace_back();
+            else if (inEntity && depth == memberDepth && field >= 0)
             {
-                const char *columnName = getField<i, Fields...>(entity).columnName.string;
-                if constexpr (std::is_same_v<std::string, FieldValueType>)
-                {
-                    if (doc.HasMember(columnName) && doc[columnName].IsString())
-                        getField<i>(entity).value = doc[columnName].GetString();
-                    else
-                        return false;
-                }
-                else if (std::is_same_v<int, FieldValueType>)
-                {
-                    if (doc.HasMember(columnName) && doc[columnName].IsInt())
-                        getField<i>(entity).value = doc[columnName].GetInt();
-                    else
-                        return false;
-                }
+                if (assignField(std::forward<V>(value), std::index_sequence_for<Fields...>{}))
+                    seen |= FieldMask(1) << field;
                 else
-                {
-                    if (doc.HasMember(columnName) && doc[columnName].IsDouble())
-                        getField<i>(entity).value = doc[columnName].GetDouble();
-                    else
-                        return false;
-                }
+                    valid = false;
+                field = -1;
+            }
+            return true;
+        }
+
+        // An object or array opening at the current depth.
+        inline void nested()
+        {
+            if (inEntity && depth == memberDepth && field >= 0)
+            {
+                valid = false;
+                field = -1;
+            }
+        }
+
+    public:
+        explicit EntityReader(std::optional<EntityType> &single) : single(&single), entities(nullptr), memberDepth(1) {}
+        explicit EntityReader(std::pmr::vector<std::optional<EntityType>> &entities) : single(nullptr), entities(&entities), memberDepth(2) {}
+
+        bool Null()
+        {
+            return scalar(nullptr);
+        }
+
+        bool Bool(bool b)
+        {
+            return scalar(b);
+        }
+
+        bool Int(int i)
+        {
+            return scalar(i);
+        }
+
+        bool Uint(unsigned u)
+        {
+            if (u <= static_cast<unsigned>(std::numeric_limits<int>::max()))
+                return scalar(static_cast<int>(u));
+            return scalar(u);
+        }
+
+        bool Int64(std::int64_t i)
+        {
+            return scalar(i);
+        }
+
+        bool Uint64(std::uint64_t u)
+        {
+            return scalar(u);
+        }
+
+        bool Double(double d)
+        {
+            return scalar(d);
+        }
+
+        bool String(const char *str, rapidjson::SizeType length, bool)
+        {
+            return scalar(std::string_view(str, length));
+        }
+
+        bool StartObject()
+        {
+            if (!depth && entities)
+                return false;
+            if (entities ? depth == 1 : !depth)
+            {
+                entity = EntityType();
+                seen = 0;
+                field = -1;
+                inEntity = true;
+                valid = true;
+            }
+            else
+                nested();
+            depth++;
+            return true;
+        }
+
+        bool Key(const char *str, rapidjson::SizeType length, bool)
+        {
+            if (inEntity && depth == memberDepth)
+                field = fieldIndex(std::string_view(str, length), std::index_sequence_for<Fields...>{});
+            return true;
+        }
+
+        bool EndObject(rapidjson::SizeType)
+        {
+            depth--;
+            if (!inEntity || depth != memberDepth - 1)
                 return true;
+            inEntity = false;
+            bool complete = valid && (seen & requiredFields) == requiredFields;
+            if (single)
+            {
+                if (complete)
+                    *single = std::move(entity);
             }
-            return false;
+            else if (complete)
+                entities->emplace_back(std::move(entity));
+            else
+                entities->emplace_back();
+            return true;
+        }
+
+        bool StartArray()
+        {
+            if (!depth)
+            {
+                if (single)
+                    return false;
+            }
+            else if (entities && depth == 1)
+                entities->emplace_back();
+            else
+                nested();
+            depth++;
+            return true;
+        }
+
+        bool EndArray(rapidjson::SizeType)
+        {
+            depth--;
+            return true;
         }
     };
 
+    // SAX handler for {"update":[entity, ...], "delete":[id, ...]}. The update array is passed on to an
+    // EntityReader; delete elements that are not strings are left empty. Other members are skipped.
     template <FieldConcept... Fields>
-    struct ParseJson<0, Fields...>
+    class BatchReader : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, BatchReader<Fields...>>
     {
-        using FieldValueType = GetFieldType<0, Fields...>::type;
+    private:
+        enum class Member
+        {
+            Other,
+            Update,
+            Delete
+        };
+
+        EntityReader<Fields...> updates;
+        std::vector<std::optional<std::string>> &removals;
+        Member member = Member::Other;
+        // Depth in the whole document; the members of the outer object are at 1.
+        std::size_t depth = 0;
 
-        bool operator()(const rapidjson::Document &doc, Entity<Fields...> &entity)
+        // A value that opens no object or array; forward hands it to the update reader.
+        template <typename Forward>
+        inline bool scalar(Forward &&forward, std::optional<std::string_view> id = {})
         {
-            const char *columnName = getField<0, Fields...>(entity).columnName.string;
-            if constexpr (std::is_same_v<std::string, FieldValueType>)
+            if (!depth)
+                return false;
+            if (member == Member::Update)
+                return forward();
+            if (member == Member::Delete)
             {
-                if (doc.HasMember(columnName) && doc[columnName].IsString())
-                    getField<0>(entity).value = doc[columnName].GetString();
-                else
+                if (depth == 1)
                     return false;
+                if (depth == 2)
+                    removals.emplace_back(id);
             }
-            else if (std::is_same_v<int, FieldValueType>)
+            return true;
+        }
+
+        // An object or array opening inside the outer object.
+        template <typename Forward>
+        inline bool nested(Forward &&forward)
+        {
+            bool accepted = true;
+            if (member == Member::Update)
+                accepted = forward();
+            else if (member == Member::Delete && depth == 2)
+                removals.emplace_back();
+            depth++;
+            return accepted;
+        }
+
+    public:
+        BatchReader(std::pmr::vector<std::optional<Entity<Fields...>>> &updates, std::vector<std::optional<std::string>> &removals)
+            : updates(updates), removals(removals) {}
+
+        bool Null()
+        {
+            return scalar([this]
+                          { return updates.Null(); });
+        }
+
+        bool Bool(bool b)
+        {
+            return scalar([this, b]
+                          { return updates.Bool(b); });
+        }
+
+        bool Int(int i)
+        {
+            return scalar([this, i]
+                          { return updates.Int(i); });
+        }
+
+        bool Uint(unsigned u)
+        {
+            return scalar([this, u]
+                          { return updates.Uint(u); });
+        }
+
+        bool Int64(std::int64_t i)
+        {
+            return scalar([this, i]
+                          { return updates.Int64(i); });
+        }
+
+        bool Uint64(std::uint64_t u)
+        {
+            return scalar([this, u]
+                          { return updates.Uint64(u); });
+        }
+
+        bool Double(double d)
+        {
+            return scalar([this, d]
+                          { return updates.Double(d); });
+        }
+
+        bool String(const char *str, rapidjson::SizeType length, bool copy)
+        {
+            return scalar([this, str, length, copy]
+                          { return updates.String(str, length, copy); },
+                          std::string_view(str, length));
+        }
+
+        bool StartObject()
+        {
+            if (!depth)
             {
-                if (doc.HasMember(columnName) && doc[columnName].IsInt())
-                    getField<0>(entity).value = doc[columnName].GetInt();
-                else
-                    return false;
+                depth++;
+                return true;
             }
-            else
+            // "delete" must be an array.
+            if (member == Member::Delete && depth == 1)
+                return false;
+            return nested([this]
+                          { return updates.StartObject(); });
+        }
+
+        bool Key(const char *str, rapidjson::SizeType length, bool copy)
+        {
+            if (depth == 1)
             {
-                if (doc.HasMember(columnName) && doc[columnName].IsDouble())
-                    getField<0>(entity).value = doc[columnName].GetDouble();
-                else
-                    return false;
+                std::string_view key(str, length);
+                member = key == "update" ? Member::Update : key == "delete" ? Member::Delete
+                                                                            : Member::Other;
+                return true;
             }
+            if (member == Member::Update)
+                return updates.Key(str, length, copy);
+            return true;
+        }
+
+        bool EndObject(rapidjson::SizeType members)
+        {
+            depth--;
+            if (depth && member == Member::Update)
+                return updates.EndObject(members);
+            return true;
+        }
+
+        bool StartArray()
+        {
+            if (!depth)
+                return false;
+            return nested([this]
+                          { return updates.StartArray(); });
+        }
+
+        bool EndArray(rapidjson::SizeType elements)
+        {
+            depth--;
+            if (member == Member::Update)
+                return updates.EndArray(elements);
             return true;
         }
     };
 
+    // The reader's parse stack is taken from arena when one is given, otherwise from the heap.
+    template <FieldConcept... Fields, typename Target>
+    static inline bool read(std::string_view json, Target &target, std::pmr::memory_resource *arena)
+    {
+        EntityReader<Fields...> handler(target);
+        return readWith(json, handler, arena);
+    }
+
+    template <typename Handler>
+    static inline bool readWith(std::string_view json, Handler &handler, std::pmr::memory_resource *arena)
+    {
+        rapidjson::MemoryStream stream(json.data(), json.size());
+        rapidjson::EncodedInputStream<rapidjson::UTF8<>, rapidjson::MemoryStream> input(stream);
+        if (arena)
+        {
+            ResourceAllocator allocator(arena);
+            ArenaReader reader(&allocator);
+            return !reader.Parse(input, handler).IsError();
+        }
+        rapidjson::Reader reader;
+        return !reader.Parse(input, handler).IsError();
+    }
+
+    template <FieldConcept... Fields>
+    static inline void writeEntity(std::string &json, const Entity<Fields...> &entity, FieldMask fields)
+    {
+        bool first = true;
+        json += '{';
+        ToJson<sizeof...(Fields) - 1, Fields...>{}(json, entity, fields, first);
+        json += '}';
+    }
+
 public:
     template <bool S = true, FieldConcept... Fields>
-    static inline std::string toJson(const Entity<Fields...> &entity)
+    static inline std::string toJson(const Entity<Fields...> &entity, FieldMask fields = allFields)
     {
-        std::ostringstream sstream;
-        rapidjson::OStreamWrapper out(sstream);
-        rapidjson::Writer<rapidjson::OStreamWrapper> writer(out);
-        writer.StartObject();
-        if (S)
+        std::string json;
+        json.reserve(S * 16 + 2 + sizeof...(Fields) * estimatedFieldSize);
+        bool first = !S;
+        json += S ? "{\"success\":true" : "{";
+        ToJson<sizeof...(Fields) - 1, Fields...>{}(json, entity, fields, first);
+        json += '}';
+        return json;
+    }
+
+    // A paged result also carries "next", the cursor of the following page, or null when next is empty.
+    template <bool P = false, FieldConcept... Fields>
+    static inline std::string toJson(const std::vector<Entity<Fields...>> &entities, FieldMask fields = allFields,
+                                     const std::string &next = {})
+    {
+        std::string json;
+        std::size_t fieldCount = std::popcount(fields & ((FieldMask(1) << sizeof...(Fields)) - 1));
+        json.reserve(64 + next.size() + entities.size() * (2 + fieldCount * estimatedFieldSize));
+        json += "{\"success\":true,\"size\":";
+        appendNumber(json, static_cast<unsigned int>(entities.size()));
+        json += ",\"entities\":[";
+        for (std::size_t i = 0; i < entities.size(); i++)
+        {
+            if (i)
+                json += ',';
+            writeEntity(json, entities[i], fields);
+        }
+        json += ']';
+        if (P)
         {
-            writer.Key("success");
-            writer.Bool(true);
+            json += ",\"next\":";
+            if (next.size())
+                appendString(json, next);
+            else
+                json += "null";
         }
-        ToJson<sizeof...(Fields) - 1, Fields...>{}(writer, entity);
-        writer.EndObject();
-        return sstream.str();
+        json += '}';
+        return json;
     }
 
-    template <FieldConcept... Fields>
-    static inline std::string toJson(const std::vector<Entity<Fields...>> &entities)
-    {
-        std::ostringstream sstream;
-        rapidjson::OStreamWrapper out(sstream);
-        rapidjson::Writer<rapidjson::OStreamWrapper> writer(out);
-        writer.StartObject();
-        writer.Key("success");
-        writer.Bool(true);
-        writer.Key("size");
-        writer.Int(entities.size());
-        writer.Key("entities");
-        writer.StartArray();
-        for (const auto &e : entities)
-        {
-            std::string json = toJson<false>(e);
-            writer.RawValue(json.c_str(), json.size(), rapidjson::kObjectType);
-        }
-        writer.EndArray();
-        writer.EndObject();
-        return sstream.str();
+    // The same document for rows handed over one at a time: fetch is called with a consumer that takes
+    // each entity and returns true to continue. The row count is only known at the end, so "size"
+    // follows the array. After each row, drain is called with the document built so far; it may take
+    // the text out of it and returns false to stop. What is left is returned.
+    template <EntityConcept E, typename Fetch, typename Drain>
+    static inline std::string toJsonEach(Fetch &&fetch, Drain &&drain)
+    {
+        std::string json = "{\"success\":true,\"entities\":[";
+        unsigned int size = 0;
+        fetch([&json, &size, &drain](const E &entity)
+              {
+                  if (size++)
+                      json += ',';
+                  writeEntity(json, entity, allFields);
+                  return drain(json); });
+        json += "],\"size\":";
+        appendNumber(json, size);
+        json += '}';
+        return json;
+    }
+
+    template <EntityConcept E, typename Fetch>
+    static inline std::string toJsonEach(Fetch &&fetch)
+    {
+        return toJsonEach<E>(fetch, [](std::string &)
+                             { return true; });
     }
 
     template <bool S = true>
     static inline std::string status()
-    {   
-        std::ostringstream sstream;
-        rapidjson::OStreamWrapper out(sstream);
-        rapidjson::Writer<rapidjson::OStreamWrapper> writer(out);
-        writer.StartObject();
-        writer.Key("success");
-        writer.Bool(S);
-        writer.EndObject();
-        return sstream.str();
+    {
+        return S ? "{\"success\":true}" : "{\"success\":false}";
     }
 
-    static std::optional<std::string> parseId(const std::string &json);
+    static std::optional<std::string> parseId(std::string_view json, std::pmr::memory_resource *arena = nullptr);
+
+    // One entry per created entity: its id, or nothing if it was rejected.
+    static std::string batchStatus(const std::vector<std::optional<std::string>> &ids);
 
+    // Rows affected by each update and delete of a batch, or null for elements that were rejected.
+    static std::string batchResults(const std::vector<std::optional<int>> &updated, const std::vector<std::optional<int>> &deleted);
+
+    static std::string cacheStatistics(const EntityCache::Statistics &statistics);
+
+    // arena, if given, holds the parser's scratch memory and must stay valid until parse returns.
     template <FieldConcept... Fields>
-    static inline void parse(const std::string &json, std::optional<Entity<Fields...>> &entityOptional)
+    static inline void parse(std::string_view json, std::optional<Entity<Fields...>> &entityOptional,
+                             std::pmr::memory_resource *arena = nullptr)
     {
         entityOptional = {};
-        rapidjson::Document doc;
-        doc.Parse(json.c_str());
-        if (doc.IsNull())
-            return;
-        Entity<Fields...> entity;
-        if (ParseJson<sizeof...(Fields) - 1, Fields...>{}(doc, entity))
-            entityOptional = entity;
+        if (!read<Fields...>(json, entityOptional, arena))
+            entityOptional = {};
+    }
+
+    // Returns false unless json is an array; elements that do not describe an entity are left empty.
+    template <FieldConcept... Fields>
+    static inline bool parse(std::string_view json, std::pmr::vector<std::optional<Entity<Fields...>>> &entities,
+                             std::pmr::memory_resource *arena = nullptr)
+    {
+        entities.clear();
+        if (read<Fields...>(json, entities, arena))
+            return true;
+        entities.clear();
+        return false;
+    }
+
+    // {"update":[entity, ...], "delete":[id, ...]}, where either member may be left out. Returns false
+    // unless json is such an object; elements that are not an entity or an id are left empty.
+    template <FieldConcept... Fields>
+    static inline bool parseBatch(std::string_view json, std::pmr::vector<std::optional<Entity<Fields...>>> &updates,
+                                  std::vector<std::optional<std::string>> &removals, std::pmr::memory_resource *arena = nullptr)
+    {
+        updates.clear();
+        removals.clear();
+        BatchReader<Fields...> handler(updates, removals);
+        if (readWith(json, handler, arena))
+            return true;
+        updates.clear();
+        removals.clear();
+        return false;
     }
 };
@@ -1,21 +1,153 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <chrono>
-#include <iostream>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 template <class T>
 struct ClassName
 {
 };
 
-template <class T>
-void log(const std::string &message)
+enum class LogLevel
+{
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+// Messages below this level are compiled out; build with -DLOG_MIN_LEVEL=0 to keep debug messages.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 1
+#endif
+
+template <LogLevel L>
+static inline constexpr bool logEnabled = static_cast<int>(L) >= LOG_MIN_LEVEL;
+
+// Single producer, single consumer queue of fixed-size records. Each logging thread owns one and never
+// waits on it: when the queue is full the message is counted as dropped.
+class LogRing
+{
+public:
+    static constexpr std::size_t maxMessageLength = 232;
+
+    struct Record
+    {
+        std::int64_t time;
+        const char *source;
+        LogLevel level;
+        std::uint16_t length;
+        char message[maxMessageLength];
+    };
+
+private:
+    static constexpr std::size_t capacity = 512;
+
+    std::array<Record, capacity> records;
+    std::atomic<std::uint64_t> head;
+    std::atomic<std::uint64_t> tail;
+    std::atomic<std::uint64_t> dropped;
+
+public:
+    // Set when the owning thread exits; the ring is discarded once drained.
+    std::atomic<bool> abandoned;
+
+    LogRing() : head(0), tail(0), dropped(0), abandoned(false) {}
+
+    LogRing(const LogRing &) = delete;
+    LogRing(LogRing &&) = delete;
+    LogRing &operator=(const LogRing &) = delete;
+    LogRing &operator=(LogRing &&) = delete;
+
+    // Called by the owning thread only. Messages longer than maxMessageLength are truncated.
+    void push(std::int64_t time, const char *source, LogLevel level, std::string_view message);
+
+    // Called by the draining thread only; returns how many messages were dropped since the last call.
+    template <typename Consumer>
+    std::uint64_t drain(Consumer &&consumer)
+    {
+        std::uint64_t t = tail.load(std::memory_order_relaxed);
+        std::uint64_t h = head.load(std::memory_order_acquire);
+        for (; t != h; t++)
+            consumer(records[t & (capacity - 1)]);
+        tail.store(t, std::memory_order_release);
+        return dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    inline bool empty() const
+    {
+        return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+    }
+};
+
+// Collects messages from the per-thread rings on a background thread and writes them to stdout in
+// batches, so logging threads never take the stdout lock or format timestamps themselves. The thread
+// sleeps until a message arrives, then lets more collect for up to flushInterval before writing again.
+class Logger
+{
+public:
+    enum class Format
+    {
+        // [Source : 2026-01-01 12:00:00.000 INFO] message
+        Text,
+        // One JSON object per line with time, level, source and message.
+        Json
+    };
+
+private:
+    static constexpr std::chrono::milliseconds flushInterval{10};
+
+    std::mutex mutex;
+    std::vector<std::shared_ptr<LogRing>> rings;
+    std::atomic<Format> format;
+    std::atomic<bool> stopping;
+    // Set while the thread waits for a message; the first message then wakes it through wake.
+    alignas(64) std::atomic<bool> parked;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::int64_t cachedSecond;
+    char cachedTime[24];
+    std::thread thread;
+
+    Logger();
+    ~Logger();
+
+    LogRing &ring();
+    void run();
+    void park(std::unique_lock<std::mutex> &lock);
+    bool idle();
+    void drain(std::string &output);
+    void append(std::string &output, const LogRing::Record &record);
+
+public:
+    Logger(const Logger &) = delete;
+    Logger(Logger &&) = delete;
+    Logger &operator=(const Logger &) = delete;
+    Logger &operator=(Logger &&) = delete;
+
+    static Logger &instance();
+
+    inline void setFormat(Format newFormat)
+    {
+        format.store(newFormat, std::memory_order_relaxed);
+    }
+
+    void write(LogLevel level, const char *source, std::string_view message);
+};
+
+template <class T, LogLevel L = LogLevel::Info>
+void log(std::string_view message)
 {
-    auto now = std::chrono::system_clock::now();
-    time_t time = std::chrono::system_clock::to_time_t(now);
-    char *timeString = std::ctime(&time);
-    timeString[strlen(timeString) - 1] = 0;
-    std::cout << "[" << ClassName<T>::name << " : " << timeString << "] " << message;
-    std::cout << std::endl;
+    if constexpr (logEnabled<L>)
+        Logger::instance().write(L, ClassName<T>::name, message);
 }
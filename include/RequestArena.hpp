@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+// Scratch memory for the request a worker thread is handling, dropped all at once by reset(). Nothing in
+// it may outlive the request; bench/RequestAllocations.cpp counts what still goes to the heap.
+class RequestArena
+{
+private:
+    static constexpr std::size_t initialSize = 64 * 1024;
+
+    alignas(std::max_align_t) std::byte initial[initialSize];
+    // Requests that need more than the initial block take further blocks from the heap until reset.
+    std::pmr::monotonic_buffer_resource memory;
+
+public:
+    RequestArena() : memory(initial, initialSize) {}
+
+    RequestArena(const RequestArena &) = delete;
+    RequestArena(RequestArena &&) = delete;
+    RequestArena &operator=(const RequestArena &) = delete;
+    RequestArena &operator=(RequestArena &&) = delete;
+
+    // The arena of the calling thread.
+    static inline RequestArena &local()
+    {
+        thread_local RequestArena arena;
+        return arena;
+    }
+
+    inline std::pmr::memory_resource *resource()
+    {
+        return &memory;
+    }
+
+    inline void reset()
+    {
+        memory.release();
+    }
+};
@@ -1,100 +1,344 @@
 #pragma once
 
+#include <charconv>
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include <RestController.hpp>
 #include <Database.hpp>
+#include <EntityCache.hpp>
 #include <Json.hpp>
+#include <ResponseCache.hpp>
+#include <ResponseWriter.hpp>
+
+// State shared by the handlers; it must outlive the controller.
+struct HandlerContext
+{
+    EntityCache &entityCache;
+    ResponseCache &responseCache;
+};
 
 template <TableName T, EntityConcept E>
-RestController::Response createUpdate(Database &database, const RestController::Request &request)
+void createUpdate(Database &database, const RestController::Request &request, ResponseWriter &response,
+                  HandlerContext &context)
 {
     std::optional<E> optional;
-    Json::parse(request.second, optional);
-    std::string reponseBody;
+    Json::parse(request.content, optional, request.arena);
     if (!optional.has_value())
     {
-        reponseBody = Json::status<false>();
-        std::cout << "not parsed" << std::endl;
+        response.write(Json::status<false>());
+        log<RestController, LogLevel::Debug>("Could not parse entity.");
     }
     else
     {
         E &entity = optional.value();
         int rows = 0;
-        if (request.first.second.contains("/create"))
+        if (request.path.ends_with("/create"))
             rows = database.create<T>(entity);
         else
+        {
             rows = database.update<T>(entity);
+            context.entityCache.invalidate(T.string, database.idKey(getField<0>(entity).value));
+        }
         if (rows)
-            reponseBody = Json::toJson(entity);
+            response.write(Json::toJson(entity));
         else
-            reponseBody = Json::status<false>();
+            response.write(Json::status<false>());
+    }
+}
+
+template <TableName T, EntityConcept E>
+void createBatch(Database &database, const RestController::Request &request, ResponseWriter &response, HandlerContext &)
+{
+    // The parsed entities only live for the request.
+    std::pmr::vector<std::optional<E>> parsed(request.arena);
+    if (!Json::parse(request.content, parsed, request.arena))
+    {
+        response.write(Json::status<false>());
+        return;
     }
-    return std::make_pair("200 OK", reponseBody);
+
+    std::vector<E> valid;
+    valid.reserve(parsed.size());
+    for (auto &entity : parsed)
+        if (entity.has_value())
+            valid.push_back(std::move(entity.value()));
+
+    bool created = database.createBatch<T>(valid) > 0;
+    std::vector<std::optional<std::string>> ids(parsed.size());
+    for (std::size_t i = 0, j = 0; i < parsed.size(); i++)
+        if (parsed[i].has_value())
+        {
+            if (created)
+                ids[i] = getField<0>(valid[j]).value;
+            j++;
+        }
+    response.write(Json::batchStatus(ids));
 }
 
+// {"update":[entity, ...], "delete":[id, ...]} run as one pipelined transaction on one session.
 template <TableName T, EntityConcept E>
-RestController::Response fetchAll(Database &database, const RestController::Request &request)
+void batch(Database &database, const RestController::Request &request, ResponseWriter &response, HandlerContext &context)
+{
+    std::pmr::vector<std::optional<E>> updates(request.arena);
+    std::vector<std::optional<std::string>> removals;
+    if (!Json::parseBatch(request.content, updates, removals, request.arena))
+    {
+        response.write(Json::status<false>());
+        return;
+    }
+
+    Database::Pipeline pipeline(database);
+    std::vector<std::optional<std::size_t>> updated;
+    std::vector<std::optional<std::size_t>> deleted;
+    for (const std::optional<E> &entity : updates)
+        updated.push_back(entity.has_value() ? std::optional(pipeline.update<T>(entity.value())) : std::nullopt);
+    for (const std::optional<std::string> &id : removals)
+        deleted.push_back(id.has_value() ? std::optional(pipeline.remove<T>(id.value())) : std::nullopt);
+    std::optional<std::vector<int>> results = pipeline.execute();
+
+    for (const std::optional<E> &entity : updates)
+        if (entity.has_value())
+            context.entityCache.invalidate(T.string, database.idKey(getField<0>(entity.value()).value));
+    for (const std::optional<std::string> &id : removals)
+        if (id.has_value())
+            context.entityCache.invalidate(T.string, database.idKey(id.value()));
+
+    if (!results.has_value())
+    {
+        response.write(Json::status<false>());
+        return;
+    }
+    auto rows = [&results](const std::vector<std::optional<std::size_t>> &slots)
+    {
+        std::vector<std::optional<int>> rows;
+        rows.reserve(slots.size());
+        for (const std::optional<std::size_t> &slot : slots)
+            rows.push_back(slot.has_value() ? std::optional(results.value()[slot.value()]) : std::nullopt);
+        return rows;
+    };
+    response.write(Json::batchResults(rows(updated), rows(deleted)));
+}
+
+// Percent-decoded value of name in a URL query string.
+static inline std::optional<std::string> queryParameter(std::string_view query, std::string_view name)
 {
-    std::vector<E> all;
-    database.fetchAll<T>(all);
-    std::string allJson = Json::toJson(all);
-    return std::make_pair("200 OK", allJson);
+    while (!query.empty())
+    {
+        std::size_t end = query.find('&');
+        std::string_view pair = query.substr(0, end);
+        query = end == std::string_view::npos ? std::string_view() : query.substr(end + 1);
+        std::size_t equals = pair.find('=');
+        if (pair.substr(0, equals) != name)
+            continue;
+        std::string_view encoded = equals == std::string_view::npos ? std::string_view() : pair.substr(equals + 1);
+        std::string value;
+        for (std::size_t i = 0; i < encoded.size(); i++)
+        {
+            unsigned char decoded;
+            if (encoded[i] == '%' && i + 2 < encoded.size() &&
+                std::from_chars(encoded.data() + i + 1, encoded.data() + i + 3, decoded, 16).ptr == encoded.data() + i + 3)
+            {
+                value += static_cast<char>(decoded);
+                i += 2;
+            }
+            else
+                value += encoded[i] == '+' ? ' ' : encoded[i];
+        }
+        return value;
+    }
+    return {};
 }
 
+// Keyset pagination: ?limit=<rows>&after_id=<cursor>&fields=<column,column,...>
 template <TableName T, EntityConcept E>
-RestController::Response idOperation(Database &database, const RestController::Request &request)
+void fetchAll(Database &database, const RestController::Request &request, ResponseWriter &response, HandlerContext &)
 {
-    std::optional<std::string> optionalId = Json::parseId(request.second);
-    std::string responseBody;
+    static constexpr unsigned int defaultPageSize = 100;
+    static constexpr unsigned int maxPageSize = 1000;
+
+    unsigned int limit = defaultPageSize;
+    std::optional<std::string> limitParameter = queryParameter(request.content, "limit");
+    if (limitParameter.has_value())
+    {
+        const char *last = limitParameter->data() + limitParameter->size();
+        auto [end, error] = std::from_chars(limitParameter->data(), last, limit);
+        if (error != std::errc() || end != last || !limit)
+        {
+            response.write(Json::status<false>());
+            return;
+        }
+        limit = std::min(limit, maxPageSize);
+    }
+
+    FieldMask fields = allFields;
+    std::optional<std::string> fieldsParameter = queryParameter(request.content, "fields");
+    if (fieldsParameter.has_value())
+    {
+        // The id is always selected since it is the cursor.
+        fields = E::columnMask("id");
+        std::string_view names = fieldsParameter.value();
+        while (!names.empty())
+        {
+            std::size_t comma = names.find(',');
+            FieldMask field = E::columnMask(names.substr(0, comma));
+            if (!field)
+            {
+                response.write(Json::status<false>());
+                return;
+            }
+            fields |= field;
+            names = comma == std::string_view::npos ? std::string_view() : names.substr(comma + 1);
+        }
+    }
+
+    std::vector<E> page;
+    database.fetchPage<T>(page, fields, queryParameter(request.content, "after_id").value_or(""), limit);
+    std::string next;
+    if (page.size() == limit)
+        next = getField<0>(page.back()).value;
+    response.write(Json::toJson<true>(page, fields, next));
+}
+
+// Hands every row of table T to a consumer, as Json::toJsonEach fetches them.
+template <TableName T, EntityConcept E>
+auto eachRow(Database &database)
+{
+    return [&database](auto &&consumer)
+    {
+        E entity;
+        database.fetchEach<T>(entity, consumer);
+    };
+}
+
+// The whole fetchAll document for table T, or nothing once it reaches cap bytes.
+template <TableName T, EntityConcept E>
+std::optional<std::string> cappedBody(Database &database, std::size_t cap)
+{
+    std::string json = Json::toJsonEach<E>(eachRow<T, E>(database), [cap](std::string &json)
+                                           { return json.size() < cap; });
+    if (json.size() >= cap)
+        return std::nullopt;
+    return json;
+}
+
+// Sends the whole fetchAll document for table T as its rows are read, holding on to none of it.
+template <TableName T, EntityConcept E>
+void streamRows(Database &database, ResponseStream &stream)
+{
+    stream.write(Json::toJsonEach<E>(eachRow<T, E>(database), [&stream](std::string &json)
+                                      {
+                                          stream.write(json);
+                                          json.clear();
+                                          return !stream.failed(); }));
+}
+
+template <TableName T, EntityConcept E>
+void fetchAllStreaming(Database &database, const RestController::Request &request, ResponseStream &stream,
+                       HandlerContext &context)
+{
+    // Any query parameter asks for a single, bounded page.
+    if (request.content.size())
+    {
+        ResponseWriter page;
+        fetchAll<T, E>(database, request, page, context);
+        stream.write(page.body());
+        return;
+    }
+
+    // A table that serializes to less than maxCachedBody bytes is built once per table version and shared
+    // by every reader of that version. A larger one is never kept: the reader that finds out drops what it
+    // built and starts over, and every reader of that version streams its own.
+    static constexpr std::size_t maxCachedBody = 8 * 1024 * 1024;
+    ResponseCache::Body body = context.responseCache.get(T.string, Database::tableVersion<T>().load(), [&database]
+                                                         { return cappedBody<T, E>(database, maxCachedBody); });
+    if (body)
+        stream.write(*body);
+    else
+        streamRows<T, E>(database, stream);
+}
+
+template <TableName T, EntityConcept E>
+void idOperation(Database &database, const RestController::Request &request, ResponseWriter &response,
+                 HandlerContext &context)
+{
+    EntityCache &cache = context.entityCache;
+    // The id comes from the path for routes like /books/{id}, otherwise from the JSON body.
+    std::string_view pathId = request.params.get("id");
+    std::optional<std::string> optionalId = pathId.empty() ? Json::parseId(request.content, request.arena) : std::string(pathId);
     if (optionalId.has_value())
     {
         std::string &id = optionalId.value();
-        if (request.first.second.contains("/delete"))
+        // Keyed the way the id column matches ids, so every spelling of one row shares an entry.
+        std::string key = database.idKey(id);
+        if (request.method == RestController::HttpMethod::POST && request.path.ends_with("/delete"))
         {
-            if (database.remove<T>(id) > 0)
-                responseBody = Json::status<true>();
+            int rows = database.remove<T>(id);
+            cache.invalidate(T.string, key);
+            if (rows > 0)
+                response.write(Json::status<true>());
             else
-                responseBody = Json::status<false>();
+                response.write(Json::status<false>());
         }
+        else if (std::optional<std::string> cached = cache.find(T.string, key))
+            response.write(std::move(cached.value()));
         else
         {
+            std::uint64_t version = cache.version(T.string, key);
             std::optional<E> optionalEntity;
             database.fetchById<T>(id, optionalEntity);
             if (optionalEntity.has_value())
-                responseBody = Json::toJson(optionalEntity.value());
+            {
+                response.write(Json::toJson(optionalEntity.value()));
+                cache.store(T.string, key, response.body(), version);
+            }
             else
-                responseBody = Json::status<false>();
+                response.write(Json::status<false>());
         }
     }
     else
-        responseBody = Json::status<false>();
-    return std::make_pair("200 OK", responseBody);
+        response.write(Json::status<false>());
+}
+
+static inline void cacheStatistics(Database &, const RestController::Request &, ResponseWriter &response,
+                                   HandlerContext &context)
+{
+    response.write(Json::cacheStatistics(context.entityCache.statistics()));
 }
 
-static inline void registerHandlers(RestController &controller)
+static inline void registerHandlers(RestController &controller, HandlerContext &context)
 {
-    controller.registerEndpoint(RestController::HttpMethod::POST, "/books/create",
-                                createUpdate<Entities::Book::BookTable, Entities::Book::BookEntity>);
-    controller.registerEndpoint(RestController::HttpMethod::POST, "/stock/create",
-                                createUpdate<Entities::Stock::StockTable, Entities::Stock::StockEntity>);
-
-    controller.registerEndpoint(RestController::HttpMethod::POST, "/books/update",
-                                createUpdate<Entities::Book::BookTable, Entities::Book::BookEntity>);
-    controller.registerEndpoint(RestController::HttpMethod::POST, "/stock/update",
-                                createUpdate<Entities::Stock::StockTable, Entities::Stock::StockEntity>);
-
-    controller.registerEndpoint(RestController::HttpMethod::GET, "/books/fetchAll",
-                                fetchAll<Entities::Book::BookTable, Entities::Book::BookEntity>);
-    controller.registerEndpoint(RestController::HttpMethod::GET, "/stock/fetchAll",
-                                fetchAll<Entities::Stock::StockTable, Entities::Stock::StockEntity>);
-
-    controller.registerEndpoint(RestController::HttpMethod::POST, "/books/delete",
-                                idOperation<Entities::Book::BookTable, Entities::Book::BookEntity>);
-    controller.registerEndpoint(RestController::HttpMethod::POST, "/stock/delete",
-                                idOperation<Entities::Stock::StockTable, Entities::Stock::StockEntity>);
-
-    controller.registerEndpoint(RestController::HttpMethod::POST, "/books/fetchById",
-                                idOperation<Entities::Book::BookTable, Entities::Book::BookEntity>);
-
-    controller.registerEndpoint(RestController::HttpMethod::POST, "/stock/fetchById",
-                                idOperation<Entities::Stock::StockTable, Entities::Stock::StockEntity>);
+    using namespace Entities::Book;
+    using namespace Entities::Stock;
+    using enum RestController::HttpMethod;
+
+    controller.registerEndpoint<createUpdate<BookTable, BookEntity>>(POST, "/books/create", context);
+    controller.registerEndpoint<createUpdate<StockTable, StockEntity>>(POST, "/stock/create", context);
+
+    controller.registerEndpoint<createBatch<BookTable, BookEntity>>(POST, "/books/createBatch", context);
+    controller.registerEndpoint<createBatch<StockTable, StockEntity>>(POST, "/stock/createBatch", context);
+
+    controller.registerEndpoint<createUpdate<BookTable, BookEntity>>(POST, "/books/update", context);
+    controller.registerEndpoint<createUpdate<StockTable, StockEntity>>(POST, "/stock/update", context);
+
+    controller.registerEndpoint<batch<BookTable, BookEntity>>(POST, "/books/batch", context);
+    controller.registerEndpoint<batch<StockTable, StockEntity>>(POST, "/stock/batch", context);
+
+    controller.registerStreamingEndpoint<fetchAllStreaming<BookTable, BookEntity>>(GET, "/books/fetchAll", context);
+    controller.registerStreamingEndpoint<fetchAllStreaming<StockTable, StockEntity>>(GET, "/stock/fetchAll", context);
+
+    controller.registerEndpoint<idOperation<BookTable, BookEntity>>(POST, "/books/delete", context);
+    controller.registerEndpoint<idOperation<StockTable, StockEntity>>(POST, "/stock/delete", context);
+
+    controller.registerEndpoint<idOperation<BookTable, BookEntity>>(POST, "/books/fetchById", context);
+    controller.registerEndpoint<idOperation<StockTable, StockEntity>>(POST, "/stock/fetchById", context);
+
+    controller.registerEndpoint<idOperation<BookTable, BookEntity>>(GET, "/books/{id}", context);
+    controller.registerEndpoint<idOperation<StockTable, StockEntity>>(GET, "/stock/{id}", context);
+
+    controller.registerEndpoint<cacheStatistics>(GET, "/cache/statistics", context);
 }
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+// One serialized response per table, tagged with the table version it was built from. Readers share
+// the immutable body; when it is stale, only one of them rebuilds it while the others wait.
+// A body can outgrow what is worth keeping; readers of that version then produce their own.
+class ResponseCache
+{
+public:
+    using Body = std::shared_ptr<const std::string>;
+    // Returns the body, or nothing when it outgrew the cache.
+    using Build = std::function<std::optional<std::string>()>;
+
+private:
+    struct Entry
+    {
+        Body body;
+        std::uint64_t version = 0;
+        // The newest version whose body outgrew the cache, if any.
+        std::optional<std::uint64_t> outgrown;
+        bool building = false;
+    };
+
+    std::mutex mutex;
+    std::condition_variable built;
+    std::map<const char *, Entry> entries;
+
+    static bool tooLarge(const Entry &entry, std::uint64_t version);
+
+public:
+    ResponseCache() = default;
+
+    ResponseCache(const ResponseCache &) = delete;
+    ResponseCache(ResponseCache &&) = delete;
+    ResponseCache &operator=(const ResponseCache &) = delete;
+    ResponseCache &operator=(ResponseCache &&) = delete;
+
+    // Returns the body for table built at version or later, calling build if there is none, or nullptr
+    // when the body for that version outgrew the cache.
+    // If build throws, the exception reaches this caller and a waiting reader builds instead.
+    Body get(const char *table, std::uint64_t version, const Build &build);
+};
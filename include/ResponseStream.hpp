@@ -0,0 +1,60 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+
+#include <Connection.hpp>
+
+// Streams a 200 response with chunked transfer encoding to the client socket. Used by a worker while it
+// owns a busy connection. The socket is never waited on while it takes data; what it does not take
+// is kept, and finish() leaves it in the connection's output for the event loop to send, so the
+// worker and its database lease are free while a slow reader catches up. Only a handler more than
+// maxBacklog bytes ahead of the reader waits, and a reader that takes nothing for stallTimeout ends
+// the stream.
+class ResponseStream
+{
+private:
+    static constexpr std::size_t flushThreshold = 64 * 1024;
+    static constexpr std::size_t maxBacklog = 1024 * 1024;
+    static constexpr int stallTimeout = 250;
+    static constexpr std::size_t maxIovecs = 64;
+
+    Connection &connection;
+    std::string header;
+    std::string chunk;
+    // Bytes the socket has not taken yet, oldest first; backlogOffset of the front one were sent.
+    std::deque<std::string> backlog;
+    std::size_t backlogOffset;
+    std::size_t backlogSize;
+    bool headerSent;
+    bool finished;
+    bool error;
+
+    std::size_t sendNow(struct iovec *&iov, std::size_t &count);
+    bool sendBacklog();
+    void send(struct iovec *iov, std::size_t count);
+    void flush(bool last, std::string_view data = {});
+
+public:
+    ResponseStream(Connection &connection, const char *connectionHeader);
+
+    ResponseStream(const ResponseStream &) = delete;
+    ResponseStream(ResponseStream &&) = delete;
+    ResponseStream &operator=(const ResponseStream &) = delete;
+    ResponseStream &operator=(ResponseStream &&) = delete;
+
+    void write(std::string_view data);
+
+    // Queues the last chunk and the terminating zero-length chunk, and leaves whatever the socket has
+    // not taken in the connection's output.
+    void finish();
+
+    inline bool failed() const
+    {
+        return error;
+    }
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+enum class Status
+{
+    Ok,
+    BadRequest,
+    NotFound,
+    PayloadTooLarge,
+    ServiceUnavailable
+};
+
+// Collects what a handler answers. The body is handed to the connection as an output segment without
+// being copied, so handlers can serialize straight into it.
+class ResponseWriter
+{
+private:
+    Status responseStatus;
+    std::string responseBody;
+
+public:
+    ResponseWriter() : responseStatus(Status::Ok) {}
+
+    ResponseWriter(const ResponseWriter &) = delete;
+    ResponseWriter(ResponseWriter &&) = delete;
+    ResponseWriter &operator=(const ResponseWriter &) = delete;
+    ResponseWriter &operator=(ResponseWriter &&) = delete;
+
+    static inline constexpr const char *statusLine(Status status)
+    {
+        switch (status)
+        {
+        case Status::Ok:
+            return "200 OK";
+        case Status::BadRequest:
+            return "400 Bad Request";
+        case Status::NotFound:
+            return "404 Not Found";
+        case Status::PayloadTooLarge:
+            return "413 Payload Too Large";
+        case Status::ServiceUnavailable:
+            return "503 Service Unavailable";
+        }
+        return "500 Internal Server Error";
+    }
+
+    inline void status(Status status)
+    {
+        responseStatus = status;
+    }
+
+    inline Status status() const
+    {
+        return responseStatus;
+    }
+
+    inline void write(std::string_view data)
+    {
+        responseBody.append(data);
+    }
+
+    inline void write(std::string &&data)
+    {
+        if (responseBody.empty())
+            responseBody = std::move(data);
+        else
+            responseBody.append(data);
+    }
+
+    inline std::string &body()
+    {
+        return responseBody;
+    }
+};
@@ -1,26 +1,29 @@
 #pragma once
 
-#include <arpa/inet.h>
-#include <fcntl.h>
-#include <netinet/in.h>
-#include <poll.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <unistd.h>
-
 #include <algorithm>
+#include <array>
 #include <cctype>
 #include <chrono>
 #include <functional>
-#include <map>
+#include <memory>
+#include <memory_resource>
 #include <optional>
-#include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <utility>
+#include <vector>
 
+#include <Connection.hpp>
 #include <Database.hpp>
+#include <DatabasePool.hpp>
+#include <EventLoop.hpp>
+#include <HttpParser.hpp>
 #include <Log.hpp>
+#include <RequestArena.hpp>
+#include <ResponseStream.hpp>
+#include <ResponseWriter.hpp>
+#include <Router.hpp>
 #include <ThreadPool.hpp>
 
 class RestController
@@ -32,26 +35,54 @@ public:
         POST
     };
 
-    using Endpoint = std::pair<HttpMethod, std::string>;
-    using Request = std::pair<Endpoint, std::string>;
-    using Response = std::pair<std::string, std::string>;
-    using EndpointHandler = std::function<Response(Database &database, const Request &)>;
+    // Views into the connection's input buffer, valid while the handler runs.
+    struct Request
+    {
+        HttpMethod method;
+        std::string_view path;
+        // The JSON body of a POST or the raw query string of a GET.
+        std::string_view content;
+        Router::Params params;
+        // Scratch memory released when the request has been answered; see RequestArena.
+        std::pmr::memory_resource *arena = nullptr;
+    };
 
 private:
+    static constexpr std::chrono::seconds keepAliveTimeout{5};
+
+    using Invoke = void (*)(void *context, Database &database, const Request &, ResponseWriter &);
+    using StreamingInvoke = void (*)(void *context, Database &database, const Request &, ResponseStream &);
+
+    // The handler is fixed at compile time; the route only keeps a plain function that calls it with
+    // the context it was registered with. Exactly one of invoke and streamingInvoke is set.
+    struct Route
+    {
+        Invoke invoke;
+        StreamingInvoke streamingInvoke;
+        void *context;
+    };
+
     bool running;
-    int socketFd;
     int port;
-    std::thread listener;
-    ThreadPool<int> workerPool;
-    std::map<Endpoint, EndpointHandler> endpoints;
-    Database database;
+    std::size_t maxRequestSize;
+    std::vector<Route> routes;
+    // One router per HttpMethod, frozen by startController.
+    std::array<Router, 2> routers;
+    DatabasePool databasePool;
+    std::vector<std::unique_ptr<EventLoop>> loops;
+    ThreadPool<Connection *> workerPool;
 
-    std::optional<Request> parseRequest(const char *requestBuffer);
-    void handleClient(int clientSocket);
-    void acceptConnections();
+    static std::optional<Request> parseRequest(const HttpParser::Message &message);
+    void addRoute(HttpMethod method, const std::string &endpoint, const Route &route);
+    bool dispatchRequest(Connection &connection);
+    void dispatchBatch(const std::vector<Connection *> &connections);
+    void handleClient(Connection *connection);
 
 public:
-    explicit RestController(int threadCount = 10, int port = 8080);
+    explicit RestController(int threadCount = 10, int port = 8080,
+                            PoolScheduling scheduling = PoolScheduling::SharedQueue,
+                            std::size_t maxRequestSize = 16 * 1024 * 1024,
+                            IdStorage idStorage = IdStorage::Text);
 
     ~RestController();
 
@@ -60,7 +91,25 @@ public:
     RestController &operator=(const RestController &) = delete;
     RestController &operator=(RestController &&) = delete;
 
-    void registerEndpoint(HttpMethod method, const std::string &endpoint, const EndpointHandler &handler);
+    // Handler is called as Handler(database, request, response, context) and context must outlive the controller.
+    // Endpoints may contain parameters, as in /books/{id}; they can only be registered before the controller starts.
+    template <auto Handler, typename Context>
+    void registerEndpoint(HttpMethod method, const std::string &endpoint, Context &context)
+    {
+        Invoke invoke = [](void *context, Database &database, const Request &request, ResponseWriter &response)
+        { Handler(database, request, response, *static_cast<Context *>(context)); };
+        addRoute(method, endpoint, Route{invoke, nullptr, &context});
+    }
+
+    // Handler is called as Handler(database, request, stream, context).
+    template <auto Handler, typename Context>
+    void registerStreamingEndpoint(HttpMethod method, const std::string &endpoint, Context &context)
+    {
+        StreamingInvoke invoke = [](void *context, Database &database, const Request &request, ResponseStream &stream)
+        { Handler(database, request, stream, *static_cast<Context *>(context)); };
+        addRoute(method, endpoint, Route{nullptr, invoke, &context});
+    }
+
     void startController();
     void stopController();
 };
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Trie over path segments. Routes are patterns like /books/{id}; a literal segment is preferred over a
+// parameter at the same position. Routes are added while setting up, then the router is frozen and
+// matched without allocating, from the views the parser hands out.
+class Router
+{
+public:
+    static constexpr std::size_t maxParams = 8;
+    static constexpr std::size_t noRoute = static_cast<std::size_t>(-1);
+
+    // Views into the pattern names and the matched path.
+    struct Params
+    {
+        std::array<std::string_view, maxParams> names;
+        std::array<std::string_view, maxParams> values;
+        std::size_t count = 0;
+
+        // Empty when there is no parameter called name.
+        inline std::string_view get(std::string_view name) const
+        {
+            for (std::size_t i = 0; i < count; i++)
+                if (names[i] == name)
+                    return values[i];
+            return {};
+        }
+    };
+
+private:
+    struct Node
+    {
+        // Sorted by segment once the router is frozen.
+        std::vector<std::pair<std::string, std::size_t>> literals;
+        std::size_t parameter = noRoute;
+        std::string parameterName;
+        std::size_t route = noRoute;
+    };
+
+    std::vector<Node> nodes;
+    bool frozen;
+
+    std::size_t child(std::size_t node, std::string_view segment);
+    std::size_t match(std::size_t node, std::string_view path, Params &params) const;
+
+public:
+    Router() : nodes(1), frozen(false) {}
+
+    // Registers route under pattern, replacing any route already there. Fails once frozen, if the
+    // pattern does not start with '/' or has too many parameters, or if it names a parameter differently
+    // from a route sharing its prefix, as /a/{y}/c does after /a/{x}/b.
+    bool add(std::string_view pattern, std::size_t route);
+
+    void freeze();
+
+    // The route matching path, or noRoute.
+    std::size_t match(std::string_view path, Params &params) const;
+};
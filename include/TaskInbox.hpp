@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free inbox of intrusively linked nodes (Node::next). Any thread may push; any thread may take
+// everything pushed so far at once, oldest first. Nodes are never taken one at a time, so concurrent
+// takers cannot run into ABA.
+template <typename Node>
+class TaskInbox
+{
+private:
+    // On its own cache line, since every producer writes it.
+    alignas(64) std::atomic<Node *> head;
+
+public:
+    TaskInbox() : head(nullptr) {}
+
+    TaskInbox(const TaskInbox &) = delete;
+    TaskInbox(TaskInbox &&) = delete;
+    TaskInbox &operator=(const TaskInbox &) = delete;
+    TaskInbox &operator=(TaskInbox &&) = delete;
+
+    void push(Node *node)
+    {
+        Node *top = head.load(std::memory_order_relaxed);
+        do
+            node->next = top;
+        while (!head.compare_exchange_weak(top, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Returns the oldest node with the others linked behind it, or nullptr when the inbox is empty.
+    Node *takeAll()
+    {
+        if (!head.load(std::memory_order_relaxed))
+            return nullptr;
+        Node *node = head.exchange(nullptr, std::memory_order_acquire);
+        Node *oldest = nullptr;
+        while (node)
+        {
+            Node *next = node->next;
+            node->next = oldest;
+            oldest = node;
+            node = next;
+        }
+        return oldest;
+    }
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string_view>
+
+// Byte scanners over JSON text, with SSE2 and AVX2 kernels besides the scalar one. The widest kernel
+// set the CPU supports is selected once at startup; until then, and on other architectures, the scalar
+// kernels are used.
+class TextScan
+{
+public:
+    using Kernel = const char *(*)(const char *begin, const char *end);
+
+    struct Kernels
+    {
+        Kernel skipWhitespace;
+        Kernel findEscape;
+        const char *name;
+    };
+
+private:
+    static Kernels kernels;
+
+public:
+    // First byte in [begin, end) that is not JSON white space, or end.
+    static inline const char *skipWhitespace(const char *begin, const char *end)
+    {
+        return kernels.skipWhitespace(begin, end);
+    }
+
+    // First '"', '\\' or control character in [begin, end), or end; the bytes before it need no escaping.
+    static inline const char *findEscape(const char *begin, const char *end)
+    {
+        return kernels.findEscape(begin, end);
+    }
+
+    // "avx2", "sse2" or "scalar".
+    static inline const char *kernelName()
+    {
+        return kernels.name;
+    }
+
+    // Installs the kernels for the running CPU; called during static initialization.
+    static void select();
+
+    // Installs the kernel set called name instead, for benchmarks. Fails if the CPU does not support it.
+    // Not safe while other threads scan.
+    static bool select(std::string_view name);
+};
+
+// Lets the bundled rapidjson reader use these kernels for in-memory input when it is built without its
+// own compile-time SIMD paths. Must be defined before any rapidjson header is included.
+#define RAPIDJSON_SCAN_DISPATCH TextScan
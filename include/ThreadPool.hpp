@@ -1,10 +1,26 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <thread>
+#include <memory>
 #include <mutex>
 #include <functional>
+#include <optional>
 #include <queue>
+#include <random>
 #include <utility>
+#include <vector>
+
+#include <TaskInbox.hpp>
+#include <WorkStealingDeque.hpp>
+
+enum class PoolScheduling
+{
+    SharedQueue,
+    WorkStealing
+};
 
 template <typename T>
 class ThreadPool
@@ -13,38 +29,172 @@ public:
     using Work = std::function<void(T)>;
 
 private:
-    using Task = std::pair<Work, T>;
+    struct Task
+    {
+        Work work;
+        T param;
+        // Link while the task waits in an inbox.
+        Task *next;
+    };
+
+    static inline thread_local ThreadPool *currentPool = nullptr;
+    static inline thread_local std::size_t currentWorker = 0;
+    // Where the calling thread hands its next task when it is not a worker; each producer thread
+    // starts somewhere else and goes round the workers.
+    static inline thread_local std::size_t producerCursor = std::hash<std::thread::id>{}(std::this_thread::get_id());
 
+    PoolScheduling scheduling;
     std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WorkStealingDeque<Task *>>> deques;
+    // Work stealing only: one inbox per worker for tasks from threads outside the pool, so producers
+    // never share a lock.
+    std::vector<std::unique_ptr<TaskInbox<Task>>> inboxes;
     std::queue<Task> taskQueue;
     std::mutex mutex;
-    bool stop;
+    std::condition_variable condition;
+    std::atomic<bool> stop;
+    // Tasks queued anywhere in the pool that no worker has started yet.
+    std::atomic<std::size_t> pending;
+    // Work stealing only: workers parked on condition, so producers skip the lock when none are.
+    std::atomic<std::size_t> sleeping;
+    // Tasks queued or running; drain() waits for it to reach zero.
+    std::atomic<std::size_t> unfinished;
+    std::atomic<bool> draining;
+    std::condition_variable drained;
+
+    void finished()
+    {
+        if (--unfinished == 0 && draining)
+        {
+            std::unique_lock lock(mutex);
+            drained.notify_all();
+        }
+    }
+
+    void run(std::size_t index)
+    {
+        if (scheduling == PoolScheduling::WorkStealing)
+            runStealing(index);
+        else
+            runShared();
+    }
 
-    void run()
+    void runShared()
     {
-        while (!stop)
+        while (true)
         {
             std::unique_lock lock(mutex);
-            if (!taskQueue.empty())
+            condition.wait(lock, [this]
+                           { return stop || !taskQueue.empty(); });
+            // Queued tasks are still drained after stop is requested.
+            if (taskQueue.empty())
+                return;
+            Task t = std::move(taskQueue.front());
+            taskQueue.pop();
+            pending--;
+            lock.unlock();
+            t.work(t.param);
+            finished();
+        }
+    }
+
+    void runStealing(std::size_t index)
+    {
+        currentPool = this;
+        currentWorker = index;
+        WorkStealingDeque<Task *> &own = *deques[index];
+        std::minstd_rand random(index + 1);
+        while (true)
+        {
+            std::optional<Task *> task = own.pop();
+            if (!task.has_value())
+                task = collect(*inboxes[index], own);
+            if (!task.has_value())
+                task = steal(index, random);
+            if (task.has_value())
             {
-                Task t = taskQueue.front();
-                taskQueue.pop();
-                lock.unlock();
-                t.first(t.second);
+                pending--;
+                std::unique_ptr<Task> t(task.value());
+                t->work(t->param);
+                t.reset();
+                finished();
+                continue;
             }
+            std::unique_lock lock(mutex);
+            // A producer increments pending before it reads sleeping, and this worker increments
+            // sleeping before it reads pending, so one of them always sees the other.
+            sleeping++;
+            condition.wait(lock, [this]
+                           { return stop || pending > 0; });
+            sleeping--;
+            if (stop && pending == 0)
+                return;
+        }
+    }
+
+    // Tries the other workers' deques first, then their inboxes, starting at a random victim.
+    std::optional<Task *> steal(std::size_t index, std::minstd_rand &random)
+    {
+        std::size_t count = deques.size();
+        std::size_t start = random() % count;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            std::size_t victim = (start + i) % count;
+            if (victim == index)
+                continue;
+            std::optional<Task *> task = deques[victim]->steal();
+            if (task.has_value())
+                return task;
+        }
+        for (std::size_t i = 0; i < count; i++)
+        {
+            std::size_t victim = (start + i) % count;
+            if (victim == index)
+                continue;
+            std::optional<Task *> task = collect(*inboxes[victim], *deques[index]);
+            if (task.has_value())
+                return task;
+        }
+        return {};
+    }
+
+    // Empties inbox into the worker's own deque, where other workers can steal from it, and returns
+    // the oldest task to run.
+    std::optional<Task *> collect(TaskInbox<Task> &inbox, WorkStealingDeque<Task *> &own)
+    {
+        Task *first = inbox.takeAll();
+        if (!first)
+            return {};
+        for (Task *task = first->next; task;)
+        {
+            Task *next = task->next;
+            own.push(task);
+            task = next;
         }
+        return first;
     }
 
 public:
-    explicit ThreadPool(int threadCount)
+    explicit ThreadPool(int threadCount, PoolScheduling scheduling = PoolScheduling::SharedQueue)
+        : scheduling(scheduling), stop(false), pending(0), sleeping(0), unfinished(0), draining(false)
     {
+        if (scheduling == PoolScheduling::WorkStealing)
+            for (int i = 0; i < threadCount; i++)
+            {
+                deques.push_back(std::make_unique<WorkStealingDeque<Task *>>());
+                inboxes.push_back(std::make_unique<TaskInbox<Task>>());
+            }
         for (int i = 0; i < threadCount; i++)
-            threads.push_back(std::thread(&ThreadPool::run, this));
+            threads.push_back(std::thread(&ThreadPool::run, this, i));
     }
 
     ~ThreadPool()
     {
-        stop = true;
+        {
+            std::unique_lock lock(mutex);
+            stop = true;
+        }
+        condition.notify_all();
         for (int i = 0; i < threads.size(); i++)
             threads[i].join();
     }
@@ -55,8 +205,76 @@ public:
     ThreadPool &operator=(ThreadPool &&) = delete;
 
     void addTask(const Work &task, const T param)
+    {
+        unfinished++;
+        if (scheduling == PoolScheduling::WorkStealing)
+        {
+            Task *t = new Task{task, param, nullptr};
+            // Tasks spawned by a worker stay on its own deque where idle workers can steal them; the
+            // others are dealt round the workers' inboxes.
+            if (currentPool == this)
+                deques[currentWorker]->push(t);
+            else
+                inboxes[producerCursor++ % inboxes.size()]->push(t);
+            pending++;
+            if (sleeping == 0)
+                return;
+            // Taking the lock orders the update against a worker that is about to park.
+            std::unique_lock lock(mutex);
+        }
+        else
+        {
+            std::unique_lock lock(mutex);
+            taskQueue.push(Task{task, param, nullptr});
+            pending++;
+        }
+        condition.notify_one();
+    }
+
+    // Queues task once per param and wakes at most as many workers as there are params, taking the
+    // lock once for the whole batch.
+    void addTasks(const Work &task, const std::vector<T> &params)
+    {
+        if (params.empty())
+            return;
+        unfinished += params.size();
+        if (scheduling == PoolScheduling::WorkStealing)
+        {
+            for (const T &param : params)
+            {
+                Task *t = new Task{task, param, nullptr};
+                if (currentPool == this)
+                    deques[currentWorker]->push(t);
+                else
+                    inboxes[producerCursor++ % inboxes.size()]->push(t);
+            }
+            pending += params.size();
+            if (sleeping == 0)
+                return;
+            std::unique_lock lock(mutex);
+        }
+        else
+        {
+            std::unique_lock lock(mutex);
+            for (const T &param : params)
+                taskQueue.push(Task{task, param, nullptr});
+            pending += params.size();
+        }
+        if (params.size() >= threads.size())
+            condition.notify_all();
+        else
+            for (std::size_t i = 0; i < params.size(); i++)
+                condition.notify_one();
+    }
+
+    // Blocks until every task queued so far, and any it spawns, has finished running. Workers keep
+    // running afterwards.
+    void drain()
     {
         std::unique_lock lock(mutex);
-        taskQueue.push(std::make_pair(task, param));
+        draining = true;
+        drained.wait(lock, [this]
+                     { return unfinished == 0; });
+        draining = false;
     }
 };
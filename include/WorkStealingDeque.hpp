@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Chase-Lev deque: the owner thread pushes and pops at the bottom, any other thread may steal from the top.
+template <typename E>
+class WorkStealingDeque
+{
+private:
+    struct Array
+    {
+        std::int64_t capacity;
+        std::unique_ptr<std::atomic<E>[]> buffer;
+
+        explicit Array(std::int64_t capacity) : capacity(capacity), buffer(new std::atomic<E>[capacity]) {}
+
+        inline E get(std::int64_t i) const
+        {
+            return buffer[i & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+
+        inline void put(std::int64_t i, E e)
+        {
+            buffer[i & (capacity - 1)].store(e, std::memory_order_relaxed);
+        }
+    };
+
+    std::atomic<std::int64_t> top;
+    std::atomic<std::int64_t> bottom;
+    std::atomic<Array *> array;
+    // Retired arrays stay alive until destruction since a thief may still be reading them.
+    std::vector<std::unique_ptr<Array>> arrays;
+
+    Array *grow(Array *a, std::int64_t b, std::int64_t t)
+    {
+        arrays.push_back(std::make_unique<Array>(a->capacity * 2));
+        Array *bigger = arrays.back().get();
+        for (std::int64_t i = t; i < b; i++)
+            bigger->put(i, a->get(i));
+        array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+public:
+    explicit WorkStealingDeque(std::int64_t capacity = 256) : top(0), bottom(0)
+    {
+        arrays.push_back(std::make_unique<Array>(capacity));
+        array.store(arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque(WorkStealingDeque &&) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(WorkStealingDeque &&) = delete;
+
+    // Owner thread only.
+    void push(E e)
+    {
+        std::int64_t b = bottom.load(std::memory_order_relaxed);
+        std::int64_t t = top.load(std::memory_order_acquire);
+        Array *a = array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1)
+            a = grow(a, b, t);
+        a->put(b, e);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner thread only.
+    std::optional<E> pop()
+    {
+        std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Array *a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return {};
+        }
+        E e = a->get(b);
+        if (t == b)
+        {
+            // Last element: race against thieves for it.
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            if (!won)
+                return {};
+        }
+        return e;
+    }
+
+    // Any thread.
+    std::optional<E> steal()
+    {
+        std::int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return {};
+        Array *a = array.load(std::memory_order_acquire);
+        E e = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return {};
+        return e;
+    }
+};
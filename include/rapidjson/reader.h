@@ -516,6 +516,16 @@ template<> inline void SkipWhitespace(EncodedInputStream<UTF8<>, MemoryStream>&
 }
 #endif // RAPIDJSON_SIMD
 
+#if !defined(RAPIDJSON_SIMD) && defined(RAPIDJSON_SCAN_DISPATCH)
+//! Template function specialization for EncodedInputStream<UTF8<>, MemoryStream>
+/*! RAPIDJSON_SCAN_DISPATCH names a class whose static skipWhitespace(begin, end) returns the first
+    byte in the range that is not white space, with kernels chosen at run time.
+*/
+template<> inline void SkipWhitespace(EncodedInputStream<UTF8<>, MemoryStream>& is) {
+    is.is_.src_ = RAPIDJSON_SCAN_DISPATCH::skipWhitespace(is.is_.src_, is.is_.end_);
+}
+#endif // RAPIDJSON_SCAN_DISPATCH
+
 ///////////////////////////////////////////////////////////////////////////////
 // GenericReader
 
@@ -1072,6 +1082,19 @@ private:
             // Do nothing for generic version
     }
 
+#if !defined(RAPIDJSON_SIMD) && defined(RAPIDJSON_SCAN_DISPATCH)
+    // EncodedInputStream<UTF8<>, MemoryStream> -> StackStream<char>
+    static RAPIDJSON_FORCEINLINE void ScanCopyUnescapedString(EncodedInputStream<UTF8<>, MemoryStream>& is, StackStream<char>& os) {
+        const char* p = is.is_.src_;
+        const char* q = RAPIDJSON_SCAN_DISPATCH::findEscape(p, is.is_.end_);
+        SizeType length = static_cast<SizeType>(q - p);
+        if (length != 0) {
+            std::memcpy(os.Push(length), p, length);
+            is.is_.src_ = q;
+        }
+    }
+#endif // RAPIDJSON_SCAN_DISPATCH
+
 #if defined(RAPIDJSON_SSE2) || defined(RAPIDJSON_SSE42)
     // StringStream -> StackStream<char>
     static RAPIDJSON_FORCEINLINE void ScanCopyUnescapedString(StringStream& is, StackStream<char>& os) {
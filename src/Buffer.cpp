@@ -0,0 +1,66 @@
+#include <Buffer.hpp>
+
+#include <bit>
+#include <cstring>
+
+std::size_t BufferPool::classIndex(std::size_t blockSize)
+{
+    return std::countr_zero(blockSize / minBlockSize);
+}
+
+std::size_t BufferPool::blockSize(std::size_t size)
+{
+    return size <= minBlockSize ? minBlockSize : std::bit_ceil(size);
+}
+
+std::unique_ptr<char[]> BufferPool::acquire(std::size_t blockSize)
+{
+    std::size_t index = classIndex(blockSize);
+    if (index < classCount && !freeLists[index].empty())
+    {
+        std::unique_ptr<char[]> block = std::move(freeLists[index].back());
+        freeLists[index].pop_back();
+        return block;
+    }
+    return std::unique_ptr<char[]>(new char[blockSize]);
+}
+
+void BufferPool::release(std::unique_ptr<char[]> block, std::size_t blockSize)
+{
+    std::size_t index = classIndex(blockSize);
+    if (index < classCount && freeLists[index].size() < maxCachedPerClass)
+        freeLists[index].push_back(std::move(block));
+}
+
+char *Buffer::reserve(std::size_t size)
+{
+    if (writable() >= size)
+        return block.get() + end;
+    std::size_t used = end - begin;
+    if (begin && capacity - used >= size)
+    {
+        std::memmove(block.get(), block.get() + begin, used);
+        begin = 0;
+        end = used;
+        return block.get() + end;
+    }
+    std::size_t newCapacity = BufferPool::blockSize(used + size);
+    std::unique_ptr<char[]> newBlock = pool->acquire(newCapacity);
+    if (used)
+        std::memcpy(newBlock.get(), block.get() + begin, used);
+    if (block)
+        pool->release(std::move(block), capacity);
+    block = std::move(newBlock);
+    capacity = newCapacity;
+    begin = 0;
+    end = used;
+    return block.get() + end;
+}
+
+void Buffer::release()
+{
+    if (!block || !empty())
+        return;
+    pool->release(std::move(block), capacity);
+    capacity = begin = end = 0;
+}
@@ -1,22 +1,299 @@
 #include <Database.hpp>
 
+#include <cstdint>
 #include <iostream>
+#include <random>
+#include <set>
 
-Database::Database() : session(mysqlx::Session("localhost", 33060, "david", "david12345678")),
-                       schema(session.getSchema("books")) {}
+namespace
+{
+    constexpr char hexDigits[] = "0123456789abcdef";
+
+    std::string formatUuid(const unsigned char *bytes)
+    {
+        std::string text(36, '-');
+        std::size_t position = 0;
+        for (std::size_t i = 0; i < 16; i++)
+        {
+            if (i == 4 || i == 6 || i == 8 || i == 10)
+                position++;
+            text[position++] = hexDigits[bytes[i] >> 4];
+            text[position++] = hexDigits[bytes[i] & 0xF];
+        }
+        return text;
+    }
+
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    bool parseUuid(const std::string &text, unsigned char *bytes)
+    {
+        if (text.size() != 36)
+            return false;
+        std::size_t position = 0;
+        for (std::size_t i = 0; i < 16; i++)
+        {
+            if (i == 4 || i == 6 || i == 8 || i == 10)
+            {
+                if (text[position++] != '-')
+                    return false;
+            }
+            int high = hexValue(text[position++]);
+            int low = hexValue(text[position++]);
+            if (high < 0 || low < 0)
+                return false;
+            bytes[i] = static_cast<unsigned char>(high << 4 | low);
+        }
+        return true;
+    }
+
+    // "id IN (:id0, :id1, ...)" with count placeholders.
+    std::string idsCondition(std::size_t count)
+    {
+        std::string condition = "id IN (";
+        for (std::size_t i = 0; i < count; i++)
+        {
+            condition += i ? ", :id" : ":id";
+            condition += std::to_string(i);
+        }
+        condition += ")";
+        return condition;
+    }
+}
+
+Database::Database(mysqlx::Session &&session, IdStorage idStorage)
+    : session(std::move(session)), schema(this->session.getSchema("books")), idStorage(idStorage),
+      lastUsed(std::chrono::steady_clock::now()) {}
 
 Database::~Database()
 {
+    // Statements must go before the session they were prepared on.
+    removeStatements.clear();
+    updateStatements.clear();
+    selectByIdStatements.clear();
+    selectAllStatements.clear();
+    tables.clear();
     session.close();
 }
 
+bool Database::healthy()
+{
+    try
+    {
+        session.sql("SELECT 1").execute();
+        return true;
+    }
+    catch (const mysqlx::Error &)
+    {
+        return false;
+    }
+}
+
+std::string Database::idKey(std::string_view id) const
+{
+    std::string key(id);
+    if (idStorage == IdStorage::Binary)
+    {
+        // Ids that are not UUIDs match no row, and are kept as sent.
+        unsigned char bytes[16];
+        return parseUuid(key, bytes) ? formatUuid(bytes) : key;
+    }
+    // Trailing spaces count under NO PAD collations, so only case is folded.
+    for (char &c : key)
+        if (c >= 'A' && c <= 'Z')
+            c = static_cast<char>(c - 'A' + 'a');
+    return key;
+}
+
 std::string Database::generateUuid()
 {
-    std::random_device rd;
-    auto seed_data = std::array<int, std::mt19937::state_size>{};
-    std::generate(std::begin(seed_data), std::end(seed_data), std::ref(rd));
-    std::seed_seq seq(std::begin(seed_data), std::end(seed_data));
-    std::mt19937 generator(seq);
+    // Seeded once per thread, so random_device is not read on every insert.
+    thread_local std::mt19937_64 generator = []
+    {
+        std::random_device rd;
+        std::seed_seq seq{rd(), rd(), rd(), rd(), rd(), rd(), rd(), rd()};
+        return std::mt19937_64(seq);
+    }();
+
+    std::uint64_t millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+    std::uint64_t high = millis << 16 | 0x7000 | (generator() & 0x0FFF);
+    std::uint64_t low = (generator() & 0x3FFFFFFFFFFFFFFF) | 0x8000000000000000;
+
+    unsigned char bytes[16];
+    for (std::size_t i = 0; i < 8; i++)
+    {
+        bytes[i] = static_cast<unsigned char>(high >> (56 - 8 * i));
+        bytes[8 + i] = static_cast<unsigned char>(low >> (56 - 8 * i));
+    }
+    return formatUuid(bytes);
+}
+
+mysqlx::Value Database::idValue(const std::string &id) const
+{
+    if (idStorage == IdStorage::Text)
+        return id;
+    unsigned char bytes[16];
+    if (!parseUuid(id, bytes))
+        return mysqlx::Value(mysqlx::bytes(bytes, std::size_t(0)));
+    return mysqlx::Value(mysqlx::bytes(bytes, sizeof(bytes)));
+}
+
+std::string Database::readId(const mysqlx::Value &value)
+{
+    if (value.getType() != mysqlx::Value::RAW)
+        return value.get<std::string>();
+    mysqlx::bytes bytes = value.getRawBytes();
+    if (bytes.size() != 16)
+        return {};
+    return formatUuid(bytes.begin());
+}
+
+// Locks the rows of table holding the ids of entries and returns the keys of the ids found, since the
+// ids sent may be spelled differently from the stored ones and still match. The lock keeps the answer
+// true until commit.
+std::set<std::string> Database::Pipeline::lockExisting(mysqlx::Table &table, const std::vector<Operation> &entries)
+{
+    mysqlx::TableSelect select = table.select("id");
+    select.where(idsCondition(entries.size()));
+    select.lockExclusive();
+    for (std::size_t i = 0; i < entries.size(); i++)
+        select.bind("id" + std::to_string(i), database.idValue(entries[i].id));
+
+    std::set<std::string> existing;
+    for (const auto &row : select.execute())
+        existing.insert(database.idKey(readId(row[0])));
+    return existing;
+}
+
+// An insert of rows rows into table that sets every column but the id instead where the id is already taken.
+std::string Database::Pipeline::upsertQuery(const std::string &table, const std::vector<std::string> &columns,
+                                            std::size_t rows)
+{
+    std::string row = "(";
+    for (std::size_t i = 0; i < columns.size(); i++)
+        row += i ? ", ?" : "?";
+    row += ")";
+
+    std::string query = "INSERT INTO `";
+    query += std::string(database.schema.getName());
+    query += "`.`";
+    query += table;
+    query += "` (";
+    for (std::size_t i = 0; i < columns.size(); i++)
+    {
+        query += i ? ", `" : "`";
+        query += columns[i];
+        query += "`";
+    }
+    query += ") VALUES ";
+    for (std::size_t i = 0; i < rows; i++)
+    {
+        if (i)
+            query += ", ";
+        query += row;
+    }
+    query += " ON DUPLICATE KEY UPDATE ";
+    if (columns.size() == 1)
+        query += "`id` = `id`";
+    for (std::size_t i = 1; i < columns.size(); i++)
+    {
+        query += i > 1 ? ", `" : "`";
+        query += columns[i];
+        query += "` = VALUES(`";
+        query += columns[i];
+        query += "`)";
+    }
+    return query;
+}
+
+void Database::Pipeline::updateAll(const std::string &table, const Updates &entries, std::vector<int> &results)
+{
+    static constexpr std::size_t rowsPerStatement = 1000;
 
-    return uuids::to_string(uuids::uuid_random_generator{generator}());
+    mysqlx::Table t = database.schema.getTable(table);
+    std::set<std::string> existing = lockExisting(t, entries.entries);
+    // Only entries whose row exists are written, so an update never inserts one.
+    std::vector<std::size_t> rows;
+    for (std::size_t i = 0; i < entries.entries.size(); i++)
+    {
+        if (!existing.count(database.idKey(entries.entries[i].id)))
+            continue;
+        rows.push_back(i);
+        results[entries.entries[i].slot] = 1;
+    }
+
+    std::size_t width = entries.columns.size();
+    for (std::size_t first = 0; first < rows.size(); first += rowsPerStatement)
+    {
+        std::size_t last = std::min(rows.size(), first + rowsPerStatement);
+        mysqlx::SqlStatement statement = database.session.sql(upsertQuery(table, entries.columns, last - first));
+        for (std::size_t j = first; j < last; j++)
+            for (std::size_t column = 0; column < width; column++)
+                statement.bind(entries.values[rows[j] * width + column]);
+        statement.execute();
+    }
+}
+
+void Database::Pipeline::removeAll(const std::string &table, const std::vector<Operation> &entries,
+                                   std::vector<int> &results)
+{
+    mysqlx::Table t = database.schema.getTable(table);
+    std::set<std::string> existing = lockExisting(t, entries);
+    mysqlx::TableRemove remove = t.remove();
+    remove.where(idsCondition(entries.size()));
+    for (std::size_t i = 0; i < entries.size(); i++)
+        remove.bind("id" + std::to_string(i), database.idValue(entries[i].id));
+    remove.execute();
+    for (const auto &entry : entries)
+        results[entry.slot] = existing.erase(database.idKey(entry.id));
+}
+
+void Database::Pipeline::bumpVersions()
+{
+    for (std::atomic<std::uint64_t> *version : versions)
+        version->fetch_add(1);
+    versions.clear();
+}
+
+std::optional<std::vector<int>> Database::Pipeline::execute()
+{
+    std::vector<int> results(operations, 0);
+    bool committed = true;
+    try
+    {
+        database.session.startTransaction();
+        for (const auto &entries : updates)
+            updateAll(entries.first, entries.second, results);
+        for (const auto &entries : removals)
+            removeAll(entries.first, entries.second, results);
+        database.session.commit();
+    }
+    catch (const mysqlx::Error &)
+    {
+        committed = false;
+        try
+        {
+            database.session.rollback();
+        }
+        catch (const mysqlx::Error &)
+        {
+        }
+    }
+    bumpVersions();
+    updates.clear();
+    removals.clear();
+    operations = 0;
+    if (!committed)
+        return std::nullopt;
+    return results;
 }
@@ -0,0 +1,91 @@
+#include <DatabasePool.hpp>
+
+DatabasePool::DatabasePool(std::size_t minSize, std::size_t maxSize, std::chrono::milliseconds leaseTimeout,
+                           std::chrono::milliseconds healthCheckInterval, IdStorage idStorage)
+    : minSize(std::min(minSize, maxSize)), maxSize(maxSize), leaseTimeout(leaseTimeout),
+      healthCheckInterval(healthCheckInterval), idStorage(idStorage),
+      client(mysqlx::ClientOption::POOLING, true,
+             mysqlx::ClientOption::POOL_MAX_SIZE, maxSize,
+             mysqlx::ClientOption::POOL_QUEUE_TIMEOUT, leaseTimeout,
+             mysqlx::SessionOption::HOST, "localhost",
+             mysqlx::SessionOption::PORT, 33060,
+             mysqlx::SessionOption::USER, "david",
+             mysqlx::SessionOption::PWD, "david12345678"),
+      total(0)
+{
+    for (std::size_t i = 0; i < this->minSize; i++)
+    {
+        std::unique_ptr<Database> database = open();
+        if (!database)
+            break;
+        idle.push_back(std::move(database));
+        total++;
+    }
+}
+
+DatabasePool::~DatabasePool()
+{
+    idle.clear();
+    client.close();
+}
+
+std::unique_ptr<Database> DatabasePool::open()
+{
+    try
+    {
+        return std::make_unique<Database>(client.getSession(), idStorage);
+    }
+    catch (const mysqlx::Error &error)
+    {
+        log<DatabasePool, LogLevel::Error>(std::string("Could not open session: ") + error.what());
+        return nullptr;
+    }
+}
+
+std::optional<DatabasePool::Lease> DatabasePool::lease()
+{
+    std::unique_lock lock(mutex);
+    if (!available.wait_for(lock, leaseTimeout, [this]
+                            { return !idle.empty() || total < maxSize; }))
+    {
+        log<DatabasePool, LogLevel::Warning>("Timed out waiting for a session.");
+        return {};
+    }
+
+    std::unique_ptr<Database> database;
+    if (!idle.empty())
+    {
+        database = std::move(idle.back());
+        idle.pop_back();
+    }
+    else
+        total++;
+    lock.unlock();
+
+    if (database && database->idleFor() > healthCheckInterval && !database->healthy())
+    {
+        log<DatabasePool, LogLevel::Warning>("Dropping unhealthy session.");
+        database.reset();
+    }
+    if (!database)
+        database = open();
+    if (!database)
+    {
+        lock.lock();
+        total--;
+        lock.unlock();
+        available.notify_one();
+        return {};
+    }
+    return Lease(this, std::move(database));
+}
+
+void DatabasePool::release(std::unique_ptr<Database> database)
+{
+    database->touch();
+    {
+        std::unique_lock lock(mutex);
+        idle.push_back(std::move(database));
+    }
+    available.notify_one();
+}
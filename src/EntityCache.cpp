@@ -0,0 +1,100 @@
+#include <EntityCache.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+EntityCache::EntityCache(std::size_t capacity, std::size_t shardCount)
+    : shardCapacity(capacity / std::max<std::size_t>(shardCount, 1)), hits(0), misses(0)
+{
+    for (std::size_t i = 0; i < std::max<std::size_t>(shardCount, 1); i++)
+        shards.push_back(std::make_unique<Shard>());
+}
+
+std::string EntityCache::key(const char *table, const std::string &id)
+{
+    std::string key = table;
+    key += '/';
+    key += id;
+    return key;
+}
+
+EntityCache::Shard &EntityCache::shardFor(const std::string &key)
+{
+    return *shards[std::hash<std::string>{}(key) % shards.size()];
+}
+
+void EntityCache::evict(Shard &shard, std::list<std::pair<std::string, std::string>>::iterator entry)
+{
+    shard.bytes -= entry->first.size() + entry->second.size();
+    shard.index.erase(entry->first);
+    shard.entries.erase(entry);
+}
+
+std::optional<std::string> EntityCache::find(const char *table, const std::string &id)
+{
+    std::string entryKey = key(table, id);
+    Shard &shard = shardFor(entryKey);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(entryKey);
+    if (it == shard.index.end())
+    {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+    hits.fetch_add(1, std::memory_order_relaxed);
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return it->second->second;
+}
+
+std::uint64_t EntityCache::version(const char *table, const std::string &id)
+{
+    Shard &shard = shardFor(key(table, id));
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.version;
+}
+
+void EntityCache::store(const char *table, const std::string &id, std::string json, std::uint64_t version)
+{
+    std::string entryKey = key(table, id);
+    std::size_t size = entryKey.size() + json.size();
+    if (size > shardCapacity)
+        return;
+    Shard &shard = shardFor(entryKey);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.version != version)
+        return;
+    auto it = shard.index.find(entryKey);
+    if (it != shard.index.end())
+        evict(shard, it->second);
+    while (shard.bytes + size > shardCapacity)
+        evict(shard, std::prev(shard.entries.end()));
+    shard.entries.emplace_front(entryKey, std::move(json));
+    shard.index.emplace(std::move(entryKey), shard.entries.begin());
+    shard.bytes += size;
+}
+
+void EntityCache::invalidate(const char *table, const std::string &id)
+{
+    std::string entryKey = key(table, id);
+    Shard &shard = shardFor(entryKey);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.version++;
+    auto it = shard.index.find(entryKey);
+    if (it != shard.index.end())
+        evict(shard, it->second);
+}
+
+EntityCache::Statistics EntityCache::statistics()
+{
+    Statistics statistics;
+    statistics.hits = hits.load(std::memory_order_relaxed);
+    statistics.misses = misses.load(std::memory_order_relaxed);
+    for (auto &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        statistics.entries += shard->entries.size();
+        statistics.bytes += shard->bytes;
+    }
+    return statistics;
+}
@@ -0,0 +1,367 @@
+#include <EventLoop.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+EventLoop::EventLoop(int port, std::chrono::milliseconds idleTimeout, std::size_t maxRequestSize,
+                     const RequestCallback &onRequest, const DispatchCallback &onDispatch)
+    : port(port), idleTimeout(idleTimeout), maxRequestSize(maxRequestSize), epollFd(-1), listenFd(-1), wakeFd(-1), running(false), onRequest(onRequest),
+      onDispatch(onDispatch), idleFirst(nullptr), idleLast(nullptr) {}
+
+EventLoop::~EventLoop()
+{
+    stop();
+    for (auto &entry : connections)
+        close(entry.first);
+    connections.clear();
+    if (wakeFd >= 0)
+        close(wakeFd);
+    if (listenFd >= 0)
+        close(listenFd);
+    if (epollFd >= 0)
+        close(epollFd);
+}
+
+bool EventLoop::createListener()
+{
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (listenFd < 0)
+    {
+        log<EventLoop, LogLevel::Error>("Could not create socket.");
+        return false;
+    }
+    int enable = 1;
+    if (setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) < 0 ||
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0)
+    {
+        log<EventLoop, LogLevel::Error>("Could not set socket options.");
+        return false;
+    }
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(struct sockaddr_in)) < 0)
+    {
+        log<EventLoop, LogLevel::Error>("Could not bind socket.");
+        return false;
+    }
+    if (listen(listenFd, listenBacklog) < 0)
+    {
+        log<EventLoop, LogLevel::Error>("Could not start listening.");
+        return false;
+    }
+    return true;
+}
+
+bool EventLoop::start()
+{
+    if (!createListener())
+        return false;
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0)
+    {
+        log<EventLoop, LogLevel::Error>("Could not create epoll instance.");
+        return false;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = &listenFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) < 0)
+    {
+        log<EventLoop, LogLevel::Error>("Could not watch listening socket.");
+        return false;
+    }
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = &wakeFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) < 0)
+    {
+        log<EventLoop, LogLevel::Error>("Could not watch wake-up descriptor.");
+        return false;
+    }
+    running = true;
+    thread = std::thread(&EventLoop::run, this);
+    return true;
+}
+
+void EventLoop::stop()
+{
+    if (!running.exchange(false))
+        return;
+    std::uint64_t one = 1;
+    write(wakeFd, &one, sizeof(one));
+    thread.join();
+}
+
+void EventLoop::resume(Connection *connection)
+{
+    {
+        std::unique_lock lock(completedMutex);
+        completed.push_back(connection);
+    }
+    std::uint64_t one = 1;
+    write(wakeFd, &one, sizeof(one));
+}
+
+void EventLoop::run()
+{
+    struct epoll_event events[maxEvents];
+    log<EventLoop>("Listening for clients...");
+    while (running)
+    {
+        // Only wake up when the least recently active connection is due to expire.
+        int timeout = -1;
+        if (idleFirst)
+        {
+            auto due = idleFirst->lastActive + idleTimeout - std::chrono::steady_clock::now();
+            timeout = std::max(0, static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(due).count()) + 1);
+        }
+        int count = epoll_wait(epollFd, events, maxEvents, timeout);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            log<EventLoop, LogLevel::Error>("Could not wait for events.");
+            break;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            void *source = events[i].data.ptr;
+            if (source == &listenFd)
+                acceptClients();
+            else if (source == &wakeFd)
+                drainCompleted();
+            else
+            {
+                Connection &connection = *static_cast<Connection *>(source);
+                if (connection.fd < 0)
+                    continue;
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                    connection.broken = true;
+                if (connection.busy)
+                    continue;
+                if (connection.broken)
+                    closeConnection(connection);
+                else
+                    service(connection);
+            }
+        }
+        // Requests found in this batch go to the workers together.
+        if (!dispatched.empty())
+        {
+            onDispatch(dispatched);
+            dispatched.clear();
+        }
+        closeIdle();
+        closed.clear();
+    }
+}
+
+void EventLoop::acceptClients()
+{
+    while (true)
+    {
+        int clientSocket = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientSocket < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            return;
+        }
+        auto connection = std::make_unique<Connection>(clientSocket, this, &bufferPool, maxRequestSize);
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = connection.get();
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, clientSocket, &event) < 0)
+        {
+            close(clientSocket);
+            continue;
+        }
+        touch(*connection);
+        connections.emplace(clientSocket, std::move(connection));
+    }
+}
+
+void EventLoop::drainCompleted()
+{
+    std::uint64_t value;
+    while (read(wakeFd, &value, sizeof(value)) > 0)
+        ;
+    std::vector<Connection *> ready;
+    {
+        std::unique_lock lock(completedMutex);
+        ready.swap(completed);
+    }
+    for (Connection *connection : ready)
+    {
+        // Time spent in a handler does not count towards the idle timeout.
+        connection->busy = false;
+        touch(*connection);
+        if (connection->broken)
+            closeConnection(*connection);
+        else
+            service(*connection);
+    }
+}
+
+void EventLoop::closeIdle()
+{
+    auto now = std::chrono::steady_clock::now();
+    while (idleFirst && now - idleFirst->lastActive > idleTimeout)
+        closeConnection(*idleFirst);
+}
+
+void EventLoop::touch(Connection &connection)
+{
+    connection.lastActive = std::chrono::steady_clock::now();
+    if (idleLast == &connection)
+        return;
+    unlink(connection);
+    connection.idlePrevious = idleLast;
+    if (idleLast)
+        idleLast->idleNext = &connection;
+    else
+        idleFirst = &connection;
+    idleLast = &connection;
+}
+
+void EventLoop::unlink(Connection &connection)
+{
+    if (connection.idlePrevious)
+        connection.idlePrevious->idleNext = connection.idleNext;
+    else if (idleFirst == &connection)
+        idleFirst = connection.idleNext;
+    else
+        return;
+    if (connection.idleNext)
+        connection.idleNext->idlePrevious = connection.idlePrevious;
+    else
+        idleLast = connection.idlePrevious;
+    connection.idlePrevious = nullptr;
+    connection.idleNext = nullptr;
+}
+
+void EventLoop::service(Connection &connection)
+{
+    while (!connection.busy)
+    {
+        if (!writeOutput(connection))
+            break;
+        if (connection.closeAfterWrite)
+        {
+            closeConnection(connection);
+            return;
+        }
+        if (!connection.readClosed)
+            readInput(connection);
+        if (connection.broken)
+            break;
+        if (connection.input.empty() || !onRequest(connection))
+        {
+            if (connection.readClosed)
+                closeConnection(connection);
+            else
+                connection.input.release();
+            return;
+        }
+    }
+    if (connection.broken)
+        closeConnection(connection);
+    else if (connection.busy)
+    {
+        unlink(connection);
+        dispatched.push_back(&connection);
+    }
+}
+
+void EventLoop::readInput(Connection &connection)
+{
+    static constexpr std::size_t chunkSize = 4096;
+    while (true)
+    {
+        // The parser reports oversized requests; anything past the limit stays in the socket.
+        if (connection.input.size() > maxRequestSize)
+            return;
+        char *space = connection.input.reserve(chunkSize);
+        ssize_t ret = recv(connection.fd, space, connection.input.writable(), 0);
+        if (ret > 0)
+        {
+            connection.input.commit(ret);
+            touch(connection);
+            continue;
+        }
+        if (ret == 0)
+            connection.readClosed = true;
+        else if (errno == EINTR)
+            continue;
+        else if (errno != EAGAIN && errno != EWOULDBLOCK)
+            connection.broken = true;
+        return;
+    }
+}
+
+bool EventLoop::writeOutput(Connection &connection)
+{
+    bool wrote = false;
+    while (!connection.output.empty())
+    {
+        struct iovec iov[maxIovecs];
+        std::size_t count = 0;
+        for (auto it = connection.output.begin(); it != connection.output.end() && count < maxIovecs; ++it, ++count)
+        {
+            std::size_t offset = count ? 0 : connection.outputOffset;
+            iov[count].iov_base = it->data() + offset;
+            iov[count].iov_len = it->size() - offset;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(struct msghdr));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t ret = sendmsg(connection.fd, &msg, MSG_NOSIGNAL);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                connection.broken = true;
+            if (wrote)
+                touch(connection);
+            return false;
+        }
+        wrote = true;
+        std::size_t sent = ret;
+        while (!connection.output.empty() && sent >= connection.output.front().size() - connection.outputOffset)
+        {
+            sent -= connection.output.front().size() - connection.outputOffset;
+            connection.output.pop_front();
+            connection.outputOffset = 0;
+        }
+        connection.outputOffset += sent;
+    }
+    if (wrote)
+        touch(connection);
+    return true;
+}
+
+void EventLoop::closeConnection(Connection &connection)
+{
+    int fd = connection.fd;
+    unlink(connection);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    auto it = connections.find(fd);
+    closed.push_back(std::move(it->second));
+    connections.erase(it);
+    connection.fd = -1;
+}
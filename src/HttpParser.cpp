@@ -0,0 +1,120 @@
+#include <HttpParser.hpp>
+
+#include <strings.h>
+
+#include <charconv>
+#include <cstring>
+
+bool HttpParser::equalsIgnoreCase(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size() && !strncasecmp(a.data(), b.data(), a.size());
+}
+
+std::string_view HttpParser::trim(std::string_view value)
+{
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+        value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+        value.remove_suffix(1);
+    return value;
+}
+
+bool HttpParser::parseRequestLine(std::string_view line)
+{
+    std::size_t methodEnd = line.find(' ');
+    if (methodEnd == std::string_view::npos || !methodEnd)
+        return false;
+    std::size_t targetEnd = line.find(' ', methodEnd + 1);
+    if (targetEnd == std::string_view::npos || targetEnd == methodEnd + 1)
+        return false;
+    std::string_view version = line.substr(targetEnd + 1);
+    if (version == "HTTP/1.0")
+        keepAlive = false;
+    else if (version != "HTTP/1.1")
+        return false;
+    method = {lineStart, methodEnd};
+    target = {lineStart + methodEnd + 1, targetEnd - methodEnd - 1};
+    return true;
+}
+
+bool HttpParser::parseHeader(std::string_view line)
+{
+    std::size_t colon = line.find(':');
+    if (colon == std::string_view::npos || !colon)
+        return false;
+    std::string_view name = line.substr(0, colon);
+    std::string_view value = trim(line.substr(colon + 1));
+    if (equalsIgnoreCase(name, "content-length"))
+    {
+        auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), contentLength);
+        return error == std::errc() && end == value.data() + value.size();
+    }
+    if (equalsIgnoreCase(name, "content-type"))
+    {
+        static constexpr std::string_view applicationJson = "application/json";
+        json = value.size() >= applicationJson.size() && equalsIgnoreCase(value.substr(0, applicationJson.size()), applicationJson);
+    }
+    else if (equalsIgnoreCase(name, "connection"))
+    {
+        if (equalsIgnoreCase(value, "close"))
+            keepAlive = false;
+        else if (equalsIgnoreCase(value, "keep-alive"))
+            keepAlive = true;
+    }
+    else if (equalsIgnoreCase(name, "transfer-encoding"))
+        return false;
+    return true;
+}
+
+HttpParser::State HttpParser::parse(std::string_view buffer)
+{
+    while (state == State::RequestLine || state == State::Headers)
+    {
+        const void *newline = std::memchr(buffer.data() + scanned, '\n', buffer.size() - scanned);
+        if (!newline)
+        {
+            scanned = buffer.size();
+            if (scanned > maxLength)
+                state = State::TooLarge;
+            else if (scanned - lineStart > maxLineLength)
+                state = State::Error;
+            return state;
+        }
+        std::size_t lineEnd = static_cast<const char *>(newline) - buffer.data();
+        std::string_view line = buffer.substr(lineStart, lineEnd - lineStart);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        if (state == State::RequestLine)
+        {
+            // Stray empty lines before a request are allowed.
+            if (!line.empty())
+                state = parseRequestLine(line) ? State::Headers : State::Error;
+        }
+        else if (line.empty())
+        {
+            bodyStart = lineEnd + 1;
+            state = contentLength > maxLength || bodyStart + contentLength > maxLength ? State::TooLarge : State::Body;
+        }
+        else if (!parseHeader(line))
+            state = State::Error;
+        lineStart = scanned = lineEnd + 1;
+    }
+
+    if (state == State::Body && buffer.size() - bodyStart >= contentLength)
+    {
+        message.method = method.in(buffer);
+        message.target = target.in(buffer);
+        message.body = buffer.substr(bodyStart, contentLength);
+        message.json = json;
+        message.keepAlive = keepAlive;
+        message.length = bodyStart + contentLength;
+        state = State::Complete;
+    }
+    return state;
+}
+
+void HttpParser::reset()
+{
+    *this = HttpParser(maxLength);
+}
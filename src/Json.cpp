@@ -1,14 +1,182 @@
 #include <Json.hpp>
 
-std::optional<std::string> Json::parseId(const std::string &json)
+#include <rapidjson/internal/dtoa.h>
+
+#include <charconv>
+#include <cmath>
+
+void Json::appendString(std::string &json, std::string_view value)
 {
-    std::string id;
-    rapidjson::Document doc;
-    doc.Parse(json.c_str()); 
-    if (doc.IsNull())
-        return {};
-    if (doc.HasMember("id") && doc["id"].IsString())
-        return doc["id"].GetString();
-    else
+    static constexpr char hexDigits[] = "0123456789ABCDEF";
+
+    json += '"';
+    const char *start = value.data();
+    const char *end = start + value.size();
+    while (true)
+    {
+        // Runs that need no escaping are found a vector at a time and copied whole.
+        const char *special = TextScan::findEscape(start, end);
+        json.append(start, special - start);
+        if (special == end)
+            break;
+        start = special + 1;
+        unsigned char c = *special;
+        switch (c)
+        {
+        case '"':
+            json += "\\\"";
+            break;
+        case '\\':
+            json += "\\\\";
+            break;
+        case '\b':
+            json += "\\b";
+            break;
+        case '\f':
+            json += "\\f";
+            break;
+        case '\n':
+            json += "\\n";
+            break;
+        case '\r':
+            json += "\\r";
+            break;
+        case '\t':
+            json += "\\t";
+            break;
+        default:
+            json += "\\u00";
+            json += hexDigits[c >> 4];
+            json += hexDigits[c & 0xF];
+        }
+    }
+    json += '"';
+}
+
+void Json::appendNumber(std::string &json, int value)
+{
+    char buffer[16];
+    json.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+}
+
+void Json::appendNumber(std::string &json, unsigned int value)
+{
+    char buffer[16];
+    json.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+}
+
+void Json::appendNumber(std::string &json, double value)
+{
+    // The same shortest form rapidjson's Writer produces, so whole numbers keep their ".0".
+    if (!std::isfinite(value))
+    {
+        json += "null";
+        return;
+    }
+    char buffer[32];
+    json.append(buffer, rapidjson::internal::dtoa(value, buffer));
+}
+
+namespace
+{
+    template <typename Document>
+    std::optional<std::string> readId(Document &doc, std::string_view json)
+    {
+        doc.Parse(json.data(), json.size());
+        if (!doc.IsObject())
+            return {};
+        auto id = doc.FindMember("id");
+        if (id != doc.MemberEnd() && id->value.IsString())
+            return id->value.GetString();
         return {};
+    }
+}
+
+std::optional<std::string> Json::parseId(std::string_view json, std::pmr::memory_resource *arena)
+{
+    if (arena)
+    {
+        // Both the DOM's pool and the parse stack come from the arena, in chunks sized for a small body.
+        using Pool = rapidjson::MemoryPoolAllocator<ResourceAllocator>;
+        ResourceAllocator allocator(arena);
+        Pool pool(1024, &allocator);
+        rapidjson::GenericDocument<rapidjson::UTF8<>, Pool, ResourceAllocator> doc(&pool, 256, &allocator);
+        return readId(doc, json);
+    }
+    rapidjson::Document doc;
+    return readId(doc, json);
+}
+
+std::string Json::batchStatus(const std::vector<std::optional<std::string>> &ids)
+{
+    std::string json;
+    StringOutput out(json);
+    Writer writer(out);
+    writer.StartObject();
+    writer.Key("success");
+    writer.Bool(true);
+    writer.Key("size");
+    writer.Int(ids.size());
+    writer.Key("results");
+    writer.StartArray();
+    for (const auto &id : ids)
+    {
+        writer.StartObject();
+        writer.Key("success");
+        writer.Bool(id.has_value());
+        if (id.has_value())
+        {
+            writer.Key("id");
+            writer.String(id->c_str(), id->size());
+        }
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return json;
+}
+
+std::string Json::batchResults(const std::vector<std::optional<int>> &updated, const std::vector<std::optional<int>> &deleted)
+{
+    std::string json;
+    StringOutput out(json);
+    Writer writer(out);
+    writer.StartObject();
+    writer.Key("success");
+    writer.Bool(true);
+    for (const auto &[key, results] : {std::pair{"updated", &updated}, std::pair{"deleted", &deleted}})
+    {
+        writer.Key(key);
+        writer.StartArray();
+        for (const std::optional<int> &rows : *results)
+        {
+            if (rows.has_value())
+                writer.Int(rows.value());
+            else
+                writer.Null();
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+    return json;
+}
+
+std::string Json::cacheStatistics(const EntityCache::Statistics &statistics)
+{
+    std::string json;
+    StringOutput out(json);
+    Writer writer(out);
+    writer.StartObject();
+    writer.Key("success");
+    writer.Bool(true);
+    writer.Key("hits");
+    writer.Uint64(statistics.hits);
+    writer.Key("misses");
+    writer.Uint64(statistics.misses);
+    writer.Key("entries");
+    writer.Uint64(statistics.entries);
+    writer.Key("bytes");
+    writer.Uint64(statistics.bytes);
+    writer.EndObject();
+    return json;
 }
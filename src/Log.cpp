@@ -0,0 +1,228 @@
+#include <Log.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace
+{
+    const char *levelName(LogLevel level)
+    {
+        switch (level)
+        {
+        case LogLevel::Debug:
+            return "DEBUG";
+        case LogLevel::Info:
+            return "INFO";
+        case LogLevel::Warning:
+            return "WARNING";
+        case LogLevel::Error:
+            return "ERROR";
+        }
+        return "";
+    }
+
+    void appendEscaped(std::string &output, std::string_view text)
+    {
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                output += '\\';
+                output += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                output += escaped;
+            }
+            else
+                output += c;
+        }
+    }
+
+    // Releases the thread's ring to the logger when the thread exits.
+    struct RingHandle
+    {
+        std::shared_ptr<LogRing> ring;
+
+        ~RingHandle()
+        {
+            if (ring)
+                ring->abandoned.store(true, std::memory_order_release);
+        }
+    };
+}
+
+void LogRing::push(std::int64_t time, const char *source, LogLevel level, std::string_view message)
+{
+    std::uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == capacity)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Record &record = records[h & (capacity - 1)];
+    record.time = time;
+    record.source = source;
+    record.level = level;
+    record.length = static_cast<std::uint16_t>(std::min(message.size(), maxMessageLength));
+    std::memcpy(record.message, message.data(), record.length);
+    if (message.size() > maxMessageLength)
+        std::memcpy(record.message + maxMessageLength - 3, "...", 3);
+    head.store(h + 1, std::memory_order_release);
+}
+
+Logger::Logger() : format(Format::Text), stopping(false), parked(false), cachedSecond(-1), thread(&Logger::run, this) {}
+
+Logger::~Logger()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping.store(true);
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+Logger &Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+LogRing &Logger::ring()
+{
+    thread_local RingHandle handle;
+    if (!handle.ring)
+    {
+        handle.ring = std::make_shared<LogRing>();
+        std::lock_guard<std::mutex> lock(mutex);
+        rings.push_back(handle.ring);
+    }
+    return *handle.ring;
+}
+
+void Logger::write(LogLevel level, const char *source, std::string_view message)
+{
+    std::int64_t time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+    ring().push(time, source, level, message);
+    // Pairs with the fence in park: either the logger sees this message or this thread sees it parked.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked.load(std::memory_order_relaxed))
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            parked.store(false, std::memory_order_relaxed);
+        }
+        wake.notify_one();
+    }
+}
+
+void Logger::append(std::string &output, const LogRing::Record &record)
+{
+    // Only the seconds are formatted with the C library, once per second.
+    std::int64_t second = record.time / 1000;
+    if (second != cachedSecond)
+    {
+        time_t time = static_cast<time_t>(second);
+        struct tm local;
+        localtime_r(&time, &local);
+        strftime(cachedTime, sizeof(cachedTime), "%Y-%m-%d %H:%M:%S", &local);
+        cachedSecond = second;
+    }
+    char millis[8];
+    snprintf(millis, sizeof(millis), ".%03d", static_cast<int>(record.time % 1000));
+    std::string_view message(record.message, record.length);
+
+    if (format.load(std::memory_order_relaxed) == Format::Json)
+    {
+        output += "{\"time\":\"";
+        output += cachedTime;
+        output += millis;
+        output += "\",\"level\":\"";
+        output += levelName(record.level);
+        output += "\",\"source\":\"";
+        output += record.source;
+        output += "\",\"message\":\"";
+        appendEscaped(output, message);
+        output += "\"}\n";
+    }
+    else
+    {
+        output += '[';
+        output += record.source;
+        output += " : ";
+        output += cachedTime;
+        output += millis;
+        output += ' ';
+        output += levelName(record.level);
+        output += "] ";
+        output += message;
+        output += '\n';
+    }
+}
+
+void Logger::drain(std::string &output)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &ring : rings)
+    {
+        std::uint64_t dropped = ring->drain([this, &output](const LogRing::Record &record)
+                                            { append(output, record); });
+        if (dropped)
+        {
+            output += "[Logger] ";
+            output += std::to_string(dropped);
+            output += " messages dropped\n";
+        }
+    }
+    // A ring is only released after the exit flag has been seen with the ring empty, so nothing is lost.
+    std::erase_if(rings, [](const std::shared_ptr<LogRing> &ring)
+                  { return ring->abandoned.load(std::memory_order_acquire) && ring->empty(); });
+}
+
+void Logger::run()
+{
+    std::string output;
+    while (true)
+    {
+        bool last = stopping.load();
+        output.clear();
+        drain(output);
+        if (!output.empty())
+        {
+            fwrite(output.data(), 1, output.size(), stdout);
+            fflush(stdout);
+        }
+        if (last)
+            return;
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        if (output.empty())
+            park(lock);
+        else
+            wake.wait_for(lock, flushInterval, [this]
+                          { return stopping.load(); });
+    }
+}
+
+void Logger::park(std::unique_lock<std::mutex> &lock)
+{
+    parked.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idle())
+        wake.wait(lock, [this]
+                  { return !parked.load(std::memory_order_relaxed) || stopping.load(); });
+    parked.store(false, std::memory_order_relaxed);
+}
+
+bool Logger::idle()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::all_of(rings.begin(), rings.end(), [](const std::shared_ptr<LogRing> &ring)
+                       { return ring->empty(); });
+}
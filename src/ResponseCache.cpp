@@ -0,0 +1,51 @@
+#include <ResponseCache.hpp>
+
+bool ResponseCache::tooLarge(const Entry &entry, std::uint64_t version)
+{
+    return entry.outgrown && entry.outgrown.value() >= version;
+}
+
+ResponseCache::Body ResponseCache::get(const char *table, std::uint64_t version, const Build &build)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    Entry &entry = entries[table];
+    while (entry.building && (!entry.body || entry.version < version) && !tooLarge(entry, version))
+        built.wait(lock);
+    if (entry.body && entry.version >= version)
+        return entry.body;
+    if (tooLarge(entry, version))
+        return nullptr;
+
+    entry.building = true;
+    lock.unlock();
+    std::optional<std::string> result;
+    try
+    {
+        result = build();
+    }
+    catch (...)
+    {
+        lock.lock();
+        entry.building = false;
+        built.notify_all();
+        throw;
+    }
+    Body body = result ? std::make_shared<const std::string>(std::move(result.value())) : nullptr;
+    lock.lock();
+    entry.building = false;
+    if (!body)
+    {
+        if (!tooLarge(entry, version))
+            entry.outgrown = version;
+        // An older body is not worth its memory once the table has outgrown the cache.
+        if (entry.body && entry.version <= version)
+            entry.body.reset();
+    }
+    else if (!entry.body || entry.version <= version)
+    {
+        entry.body = body;
+        entry.version = version;
+    }
+    built.notify_all();
+    return body;
+}
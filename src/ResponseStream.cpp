@@ -0,0 +1,164 @@
+#include <ResponseStream.hpp>
+
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+ResponseStream::ResponseStream(Connection &connection, const char *connectionHeader)
+    : connection(connection), backlogOffset(0), backlogSize(0), headerSent(false), finished(false), error(false)
+{
+    header = "HTTP/1.1 200 OK\r\nContent-Type: \"application/json\"\r\nTransfer-Encoding: chunked\r\n";
+    header += connectionHeader;
+    header += "\r\n";
+    chunk.reserve(flushThreshold);
+}
+
+// Writes what the socket takes without blocking, advances iov and count past it and returns how many
+// bytes that was; sets error if the connection failed.
+std::size_t ResponseStream::sendNow(struct iovec *&iov, std::size_t &count)
+{
+    std::size_t total = 0;
+    while (count)
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(struct msghdr));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t ret = sendmsg(connection.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                error = true;
+            return total;
+        }
+        std::size_t sent = ret;
+        total += sent;
+        while (count && sent >= iov->iov_len)
+        {
+            sent -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count)
+        {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    return total;
+}
+
+// Returns true once the backlog is empty.
+bool ResponseStream::sendBacklog()
+{
+    while (!backlog.empty() && !error)
+    {
+        struct iovec iov[maxIovecs];
+        std::size_t count = 0;
+        for (auto it = backlog.begin(); it != backlog.end() && count < maxIovecs; ++it, ++count)
+        {
+            std::size_t offset = count ? 0 : backlogOffset;
+            iov[count] = {it->data() + offset, it->size() - offset};
+        }
+        struct iovec *unsent = iov;
+        std::size_t sent = sendNow(unsent, count);
+        backlogSize -= sent;
+        while (!backlog.empty() && sent >= backlog.front().size() - backlogOffset)
+        {
+            sent -= backlog.front().size() - backlogOffset;
+            backlog.pop_front();
+            backlogOffset = 0;
+        }
+        backlogOffset += sent;
+        if (!backlog.empty() && sent == 0)
+            return false;
+    }
+    return backlog.empty();
+}
+
+void ResponseStream::send(struct iovec *iov, std::size_t count)
+{
+    // New bytes may only go straight to the socket once everything before them has.
+    if (sendBacklog())
+        sendNow(iov, count);
+    for (std::size_t i = 0; i < count && !error; i++)
+    {
+        backlog.emplace_back(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+        backlogSize += iov[i].iov_len;
+    }
+    while (!error && backlogSize > maxBacklog)
+    {
+        struct pollfd pollFd;
+        memset(&pollFd, 0, sizeof(struct pollfd));
+        pollFd.fd = connection.fd;
+        pollFd.events = POLLOUT;
+        if (poll(&pollFd, 1, stallTimeout) <= 0)
+            error = true;
+        else
+            sendBacklog();
+    }
+}
+
+void ResponseStream::flush(bool last, std::string_view data)
+{
+    static char crlf[] = "\r\n";
+    static char lastChunk[] = "0\r\n\r\n";
+
+    if (error)
+        return;
+    char sizeLine[24];
+    struct iovec iov[6];
+    std::size_t count = 0;
+    if (!headerSent)
+        iov[count++] = {header.data(), header.size()};
+    if (chunk.size() + data.size())
+    {
+        int sizeLineLength = snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", chunk.size() + data.size());
+        iov[count++] = {sizeLine, static_cast<std::size_t>(sizeLineLength)};
+        if (chunk.size())
+            iov[count++] = {chunk.data(), chunk.size()};
+        if (data.size())
+            iov[count++] = {const_cast<char *>(data.data()), data.size()};
+        iov[count++] = {crlf, sizeof(crlf) - 1};
+    }
+    if (last)
+        iov[count++] = {lastChunk, sizeof(lastChunk) - 1};
+    send(iov, count);
+    headerSent = true;
+    chunk.clear();
+}
+
+void ResponseStream::write(std::string_view data)
+{
+    if (error || finished)
+        return;
+    if (data.size() >= flushThreshold)
+    {
+        // Sent from where it is, together with anything buffered, instead of being copied into the chunk.
+        flush(false, data);
+        return;
+    }
+    chunk.append(data);
+    if (chunk.size() >= flushThreshold)
+        flush(false);
+}
+
+void ResponseStream::finish()
+{
+    if (finished)
+        return;
+    flush(true);
+    finished = true;
+    if (error)
+        return;
+    // The loop only hands over a connection once its output is empty, so the backlog goes first.
+    for (std::string &segment : backlog)
+        connection.output.push_back(std::move(segment));
+    connection.outputOffset = backlogOffset;
+    backlog.clear();
+}
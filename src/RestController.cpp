@@ -1,200 +1,210 @@
 #include <RestController.hpp>
 
-RestController::RestController(int threadCount, int port) : workerPool(threadCount), port(port) {}
+RestController::RestController(int threadCount, int port, PoolScheduling scheduling, std::size_t maxRequestSize,
+                               IdStorage idStorage)
+    : running(false), port(port), maxRequestSize(maxRequestSize),
+      databasePool(1, threadCount, std::chrono::seconds(5), std::chrono::seconds(30), idStorage),
+      workerPool(threadCount, scheduling) {}
 
 RestController::~RestController()
 {
     stopController();
 }
 
-std::optional<RestController::Request> RestController::parseRequest(const char *requestBuffer)
+std::optional<RestController::Request> RestController::parseRequest(const HttpParser::Message &message)
 {
-    std::istringstream in(requestBuffer);
-
-    std::string line;
-    if (!std::getline(in, line))
-        return {};
-
-    std::istringstream stream(line);
-    std::string endpoint;
-
-    stream >> endpoint;
     HttpMethod method;
-    if (!endpoint.compare("POST"))
+    if (message.method == "POST")
         method = HttpMethod::POST;
-    else if (!endpoint.compare("GET"))
+    else if (message.method == "GET")
         method = HttpMethod::GET;
     else
         return {};
 
-    stream >> endpoint;
-
-    std::string content;
-    if (method == HttpMethod::POST)
+    std::string_view path = message.target;
+    std::string_view query;
+    std::size_t queryStart = path.find('?');
+    if (queryStart != std::string_view::npos)
     {
-        size_t contentLength = 0;
-        bool isJson = false;
-        std::string buffer;
-        while (std::getline(in, line))
-        {
-            stream = std::istringstream(line);
-            stream >> buffer;
-            std::transform(buffer.begin(), buffer.end(), buffer.begin(), [](unsigned char c)
-                           { return std::tolower(c); });
-            if (!buffer.compare("content-type:"))
-            {
-                stream >> buffer;
-                if (!buffer.compare("application/json"))
-                    isJson = true;
-            }
-            else if (!buffer.compare("content-length:"))
-                stream >> contentLength;
-        }
-        if (isJson && contentLength)
-            content = line;
+        query = path.substr(queryStart + 1);
+        path = path.substr(0, queryStart);
     }
 
-    Endpoint endPoint = std::make_pair(method, endpoint);
-    return std::make_pair(endPoint, content);
+    Request request;
+    request.method = method;
+    request.path = path;
+    if (method == HttpMethod::POST && message.json)
+        request.content = message.body;
+    else if (method == HttpMethod::GET)
+        request.content = query;
+    return request;
 }
 
-void RestController::handleClient(int clientSocket)
+bool RestController::dispatchRequest(Connection &connection)
 {
-    static const char *notFoundResponse = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
-    static const size_t notFoundResponseLength = strlen(notFoundResponse);
-
-    char *requestBuffer = new char[4096];
-    ssize_t size = 4096;
-    char *currentPosition = requestBuffer;
-    struct pollfd pollFd;
-    memset(&pollFd, 0, sizeof(struct pollfd));
-
-    pollFd.fd = clientSocket;
-    pollFd.events = POLLIN;
-    poll(&pollFd, 1, 100);
+    HttpParser::State state = connection.parser.parse(connection.input.view());
+    if (state != HttpParser::State::Complete && state != HttpParser::State::Error &&
+        state != HttpParser::State::TooLarge)
+        return false;
+    connection.busy = true;
+    return true;
+}
 
-    while (pollFd.revents & POLLIN)
-    {
-        ssize_t ret = recv(clientSocket, currentPosition, size, 0);
-        if (ret < 0)
-            break;
-        size -= ret;
-        currentPosition += ret;
-        pollFd.revents = 0;
-        poll(&pollFd, 1, 100);
-    }
-    *currentPosition = 0;
+void RestController::dispatchBatch(const std::vector<Connection *> &connections)
+{
+    ThreadPool<Connection *>::Work poolHandler = std::bind(&RestController::handleClient, this, std::placeholders::_1);
+    workerPool.addTasks(poolHandler, connections);
+}
 
-    if (size == 4096)
+void RestController::handleClient(Connection *connection)
+{
+    if (connection->parser.getState() != HttpParser::State::Complete)
     {
-        delete[] requestBuffer;
-        close(clientSocket);
+        if (connection->parser.getState() == HttpParser::State::TooLarge)
+        {
+            log<RestController>("Request too large.");
+            connection->output.push_back("HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        }
+        else
+        {
+            log<RestController>("Malformed request.");
+            connection->output.push_back("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        }
+        connection->closeAfterWrite = true;
+        connection->loop->resume(connection);
         return;
     }
 
-    std::optional<Request> requestOptional = parseRequest(requestBuffer);
-    delete[] requestBuffer;
+    const HttpParser::Message &message = connection->parser.getMessage();
+    bool persistent = message.keepAlive;
+    const char *connectionHeader = persistent ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+
+    // The request views the input buffer, which the event loop leaves alone while the connection is busy,
+    // so the request is only consumed once it has been handled.
+    std::size_t requestLength = message.length;
+    std::optional<Request> requestOptional = parseRequest(message);
+    RequestArena &arena = RequestArena::local();
 
     bool requestServiced = false;
     if (requestOptional.has_value())
     {
-        Request request = requestOptional.value();
-        std::string message = "Method: ";
-        message += request.first.first == HttpMethod::POST ? "POST " : "GET ";
-        message += "Endpoint: ";
-        message += request.first.second;
-        if (request.second.size())
-            message += " Content: " + request.second;
-        log<RestController>(message);
-        std::map<Endpoint, EndpointHandler>::const_iterator it;
-        if ((it = endpoints.find(request.first)) != endpoints.cend())
+        Request &request = requestOptional.value();
+        request.arena = arena.resource();
+        if constexpr (logEnabled<LogLevel::Debug>)
+        {
+            std::string message = "Method: ";
+            message += request.method == HttpMethod::POST ? "POST " : "GET ";
+            message += "Endpoint: ";
+            message += request.path;
+            if (request.content.size())
+            {
+                message += " Content: ";
+                message += request.content;
+            }
+            log<RestController, LogLevel::Debug>(message);
+        }
+        std::size_t route = routers[static_cast<std::size_t>(request.method)].match(request.path, request.params);
+        if (route != Router::noRoute && routes[route].streamingInvoke)
+        {
+            std::optional<DatabasePool::Lease> lease = databasePool.lease();
+            if (lease.has_value())
+            {
+                log<RestController, LogLevel::Debug>("Streaming response...");
+                requestServiced = true;
+                ResponseStream stream(*connection, connectionHeader);
+                routes[route].streamingInvoke(routes[route].context, **lease, request, stream);
+                stream.finish();
+                if (stream.failed())
+                    persistent = false;
+                log<RestController, LogLevel::Debug>("Request serviced.");
+            }
+            else
+            {
+                requestServiced = true;
+                std::string header = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n";
+                header += connectionHeader;
+                header += "\r\n";
+                connection->output.push_back(std::move(header));
+            }
+        }
+        else if (route != Router::noRoute)
         {
-            log<RestController>("Servicing request...");
+            log<RestController, LogLevel::Debug>("Servicing request...");
             requestServiced = true;
-            Response response = it->second(database, request);
-            std::ostringstream out;
-            out << "HTTP/1.1 " << response.first << "\r\n";
-            out << "Content-Type: \"application/json\"\r\n";
-            out << "Content-Length: " << response.second.size() << "\r\n";
-            out << "\r\n";
-            out << response.second << "\r\n";
-            std::string responseString = out.str();
-            send(clientSocket, responseString.c_str(), responseString.size(), 0);
-            log<RestController>("Request serviced.");
+            ResponseWriter response;
+            {
+                std::optional<DatabasePool::Lease> lease = databasePool.lease();
+                if (lease.has_value())
+                    routes[route].invoke(routes[route].context, **lease, request, response);
+                else
+                    response.status(Status::ServiceUnavailable);
+            }
+            std::string header = "HTTP/1.1 ";
+            header += ResponseWriter::statusLine(response.status());
+            header += "\r\nContent-Type: \"application/json\"\r\nContent-Length: ";
+            header += std::to_string(response.body().size());
+            header += "\r\n";
+            header += connectionHeader;
+            header += "\r\n";
+            // Header and body stay separate segments so the body is written without another copy.
+            connection->output.push_back(std::move(header));
+            connection->output.push_back(std::move(response.body()));
+            log<RestController, LogLevel::Debug>("Request serviced.");
         }
     }
 
     if (!requestServiced)
     {
-        log<RestController>("Unknown request.");
-        send(clientSocket, notFoundResponse, notFoundResponseLength, 0);
+        log<RestController, LogLevel::Debug>("Unknown request.");
+        std::string header = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n";
+        header += connectionHeader;
+        header += "\r\n";
+        connection->output.push_back(std::move(header));
     }
 
-    close(clientSocket);
+    arena.reset();
+    connection->input.consume(requestLength);
+    connection->parser.reset();
+    connection->closeAfterWrite = !persistent;
+    connection->loop->resume(connection);
 }
 
-void RestController::acceptConnections()
+void RestController::addRoute(HttpMethod method, const std::string &endpoint, const Route &route)
 {
-    if (listen(socketFd, 100) < 0)
-    {
-        log<RestController>("Could not start listening.");
-        running = false;
+    if (running)
         return;
-    }
-    int clientSock;
-    struct sockaddr_in clientAddr;
-    socklen_t length;
-    log<RestController>("Listening for clients...");
-    while (running)
+    routes.push_back(route);
+    if (!routers[static_cast<std::size_t>(method)].add(endpoint, routes.size() - 1))
     {
-        if ((clientSock = accept(socketFd, (struct sockaddr *)&clientAddr, &length)) < 0)
-            continue;
-
-        log<RestController>("Client accepted. Forwarding to thread pool...");
-        ThreadPool<int>::Work poolHandler = std::bind(&RestController::handleClient, this, std::placeholders::_1);
-        workerPool.addTask(poolHandler, clientSock);
+        routes.pop_back();
+        log<RestController, LogLevel::Error>("Invalid endpoint: " + endpoint);
     }
 }
 
-void RestController::registerEndpoint(HttpMethod method, const std::string &endpoint, const EndpointHandler &handler)
+void RestController::startController()
 {
     if (running)
         return;
-    Endpoint key = std::make_pair(method, endpoint);
-    endpoints[key] = handler;
-}
-
-void RestController::startController()
-{
     log<RestController>("Starting controller...");
-    socketFd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (socketFd < 0)
-    {
-        log<RestController>("Could not create socket.");
-        return;
-    }
-    int socketFlags = fcntl(socketFd, F_GETFL, 0);
-    if (socketFlags < 0)
-    {
-        log<RestController>("Could not get socket flags.");
-        return;
-    }
-    if (fcntl(socketFd, F_SETFL, socketFlags | O_NONBLOCK) < 0)
+    for (auto &router : routers)
+        router.freeze();
+    unsigned int loopCount = std::max(1u, std::thread::hardware_concurrency());
+    EventLoop::RequestCallback onRequest = std::bind(&RestController::dispatchRequest, this, std::placeholders::_1);
+    EventLoop::DispatchCallback onDispatch = std::bind(&RestController::dispatchBatch, this, std::placeholders::_1);
+    for (unsigned int i = 0; i < loopCount; i++)
     {
-        log<RestController>("Could not set socket flags.");
-        return;
-    }
-    struct sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(port);
-    if (bind(socketFd, (struct sockaddr *)&addr, sizeof(struct sockaddr_in)) < 0)
-    {
-        log<RestController>("Could not bind socket.");
-        return;
+        loops.push_back(std::make_unique<EventLoop>(port, keepAliveTimeout, maxRequestSize, onRequest, onDispatch));
+        if (!loops.back()->start())
+        {
+            log<RestController, LogLevel::Error>("Could not start event loop.");
+            for (auto &loop : loops)
+                loop->stop();
+            workerPool.drain();
+            loops.clear();
+            return;
+        }
     }
     running = true;
-    listener = std::thread(&RestController::acceptConnections, this);
 }
 
 void RestController::stopController()
@@ -203,6 +213,11 @@ void RestController::stopController()
         return;
     log<RestController>("Stopping controller...");
     running = false;
-    listener.join();
-    close(socketFd);
-}
\ No newline at end of file
+    // The loops stop dispatching first; handlers already queued or running still use their
+    // connections and hand them back to their loop, so the loops are only destroyed once the
+    // workers are done with them.
+    for (auto &loop : loops)
+        loop->stop();
+    workerPool.drain();
+    loops.clear();
+}
@@ -0,0 +1,96 @@
+#include <Router.hpp>
+
+#include <algorithm>
+
+std::size_t Router::child(std::size_t node, std::string_view segment)
+{
+    if (segment.size() > 1 && segment.front() == '{' && segment.back() == '}')
+    {
+        std::string_view name = segment.substr(1, segment.size() - 2);
+        if (nodes[node].parameter == noRoute)
+        {
+            nodes[node].parameter = nodes.size();
+            nodes[node].parameterName = name;
+            nodes.emplace_back();
+        }
+        // Routes share the parameter node, so they must also share its name.
+        else if (nodes[node].parameterName != name)
+            return noRoute;
+        return nodes[node].parameter;
+    }
+    for (const auto &literal : nodes[node].literals)
+        if (literal.first == segment)
+            return literal.second;
+    std::size_t next = nodes.size();
+    nodes[node].literals.emplace_back(std::string(segment), next);
+    nodes.emplace_back();
+    return next;
+}
+
+bool Router::add(std::string_view pattern, std::size_t route)
+{
+    if (frozen || pattern.empty() || pattern.front() != '/' ||
+        static_cast<std::size_t>(std::count(pattern.begin(), pattern.end(), '{')) > maxParams)
+        return false;
+    std::size_t node = 0;
+    std::string_view path = pattern.substr(1);
+    while (true)
+    {
+        std::size_t slash = path.find('/');
+        node = child(node, path.substr(0, slash));
+        if (node == noRoute)
+            return false;
+        if (slash == std::string_view::npos)
+            break;
+        path.remove_prefix(slash + 1);
+    }
+    nodes[node].route = route;
+    return true;
+}
+
+void Router::freeze()
+{
+    for (auto &node : nodes)
+        std::sort(node.literals.begin(), node.literals.end());
+    frozen = true;
+}
+
+std::size_t Router::match(std::size_t node, std::string_view path, Params &params) const
+{
+    std::size_t slash = path.find('/');
+    std::string_view segment = path.substr(0, slash);
+    bool last = slash == std::string_view::npos;
+    std::string_view rest = last ? std::string_view() : path.substr(slash + 1);
+    const Node &current = nodes[node];
+
+    auto literal = std::lower_bound(current.literals.begin(), current.literals.end(), segment,
+                                    [](const std::pair<std::string, std::size_t> &entry, std::string_view segment)
+                                    { return std::string_view(entry.first) < segment; });
+    if (literal != current.literals.end() && literal->first == segment)
+    {
+        std::size_t route = last ? nodes[literal->second].route : match(literal->second, rest, params);
+        if (route != noRoute)
+            return route;
+    }
+
+    if (current.parameter != noRoute && !segment.empty())
+    {
+        std::size_t count = params.count;
+        params.names[count] = current.parameterName;
+        params.values[count] = segment;
+        params.count++;
+        std::size_t route = last ? nodes[current.parameter].route : match(current.parameter, rest, params);
+        if (route != noRoute)
+            return route;
+        params.count = count;
+    }
+    return noRoute;
+}
+
+std::size_t Router::match(std::string_view path, Params &params) const
+{
+    params.count = 0;
+    if (!frozen || path.empty() || path.front() != '/')
+        return noRoute;
+    return match(0, path.substr(1), params);
+}
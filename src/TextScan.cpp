@@ -0,0 +1,173 @@
+#include <TextScan.hpp>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    inline bool isWhitespace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    inline bool needsEscape(char c)
+    {
+        return static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\';
+    }
+
+    const char *skipWhitespaceScalar(const char *begin, const char *end)
+    {
+        while (begin != end && isWhitespace(*begin))
+            begin++;
+        return begin;
+    }
+
+    const char *findEscapeScalar(const char *begin, const char *end)
+    {
+        while (begin != end && !needsEscape(*begin))
+            begin++;
+        return begin;
+    }
+
+#if defined(__x86_64__)
+    // SSE2 is part of x86-64, so these need no check.
+
+    // One bit per byte of the 16 at bytes that is not white space.
+    inline unsigned int otherThanWhitespaceSse2(const char *bytes)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes));
+        __m128i whitespace = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\n'))),
+                                          _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\t'))));
+        return ~static_cast<unsigned int>(_mm_movemask_epi8(whitespace)) & 0xFFFF;
+    }
+
+    const char *skipWhitespaceSse2(const char *begin, const char *end)
+    {
+        // Most runs of white space are a byte or none, which two scalar checks settle sooner than a
+        // vector compare.
+        if (begin == end || !isWhitespace(*begin))
+            return begin;
+        const char *start = begin++;
+        if (begin == end || !isWhitespace(*begin))
+            return begin;
+        for (; end - begin >= 16; begin += 16)
+        {
+            unsigned int other = otherThanWhitespaceSse2(begin);
+            if (other)
+                return begin + __builtin_ctz(other);
+        }
+        // Everything from start to begin is white space, so a run that ends within the last 16 bytes is
+        // found with one load that overlaps it rather than byte by byte.
+        if (begin != end && end - start >= 16)
+        {
+            unsigned int other = otherThanWhitespaceSse2(end - 16);
+            return other ? end - 16 + __builtin_ctz(other) : end;
+        }
+        return skipWhitespaceScalar(begin, end);
+    }
+
+    const char *findEscapeSse2(const char *begin, const char *end)
+    {
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i lastControl = _mm_set1_epi8(0x1F);
+        for (; end - begin >= 16; begin += 16)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+            // max(byte, 0x1F) == 0x1F exactly for the unsigned bytes below 0x20.
+            __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(bytes, lastControl), lastControl);
+            __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)), control);
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(special));
+            if (mask)
+                return begin + __builtin_ctz(mask);
+        }
+        return findEscapeScalar(begin, end);
+    }
+
+    __attribute__((target("avx2"))) inline unsigned int otherThanWhitespaceAvx2(const char *bytes)
+    {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes));
+        __m256i whitespace = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n'))),
+                                             _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\t'))));
+        return ~static_cast<unsigned int>(_mm256_movemask_epi8(whitespace));
+    }
+
+    __attribute__((target("avx2"))) const char *skipWhitespaceAvx2(const char *begin, const char *end)
+    {
+        if (begin == end || !isWhitespace(*begin))
+            return begin;
+        const char *start = begin++;
+        if (begin == end || !isWhitespace(*begin))
+            return begin;
+        for (; end - begin >= 32; begin += 32)
+        {
+            unsigned int other = otherThanWhitespaceAvx2(begin);
+            if (other)
+                return begin + __builtin_ctz(other);
+        }
+        if (begin != end && end - start >= 32)
+        {
+            unsigned int other = otherThanWhitespaceAvx2(end - 32);
+            return other ? end - 32 + __builtin_ctz(other) : end;
+        }
+        // The SSE2 kernel is legacy-encoded; entered with dirty upper halves, each of its instructions
+        // would wait on a state transition, and so would the caller's SSE code after it returns.
+        _mm256_zeroupper();
+        return skipWhitespaceSse2(begin, end);
+    }
+
+    __attribute__((target("avx2"))) const char *findEscapeAvx2(const char *begin, const char *end)
+    {
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+        const __m256i lastControl = _mm256_set1_epi8(0x1F);
+        for (; end - begin >= 32; begin += 32)
+        {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+            __m256i control = _mm256_cmpeq_epi8(_mm256_max_epu8(bytes, lastControl), lastControl);
+            __m256i special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, quote), _mm256_cmpeq_epi8(bytes, backslash)), control);
+            unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(special));
+            if (mask)
+                return begin + __builtin_ctz(mask);
+        }
+        _mm256_zeroupper();
+        return findEscapeSse2(begin, end);
+    }
+#endif
+}
+
+TextScan::Kernels TextScan::kernels = {skipWhitespaceScalar, findEscapeScalar, "scalar"};
+
+void TextScan::select()
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        kernels = {skipWhitespaceAvx2, findEscapeAvx2, "avx2"};
+    else
+        kernels = {skipWhitespaceSse2, findEscapeSse2, "sse2"};
+#endif
+}
+
+bool TextScan::select(std::string_view name)
+{
+    if (name == "scalar")
+        kernels = {skipWhitespaceScalar, findEscapeScalar, "scalar"};
+#if defined(__x86_64__)
+    else if (name == "sse2")
+        kernels = {skipWhitespaceSse2, findEscapeSse2, "sse2"};
+    else if (name == "avx2" && (__builtin_cpu_init(), __builtin_cpu_supports("avx2")))
+        kernels = {skipWhitespaceAvx2, findEscapeAvx2, "avx2"};
+#endif
+    else
+        return false;
+    return true;
+}
+
+namespace
+{
+    // Runs after the constant initialization of kernels, so callers from other static initializers
+    // that run earlier still get the scalar set.
+    const bool kernelsSelected = (TextScan::select(), true);
+}
@@ -1,12 +1,17 @@
 #include <RestController.hpp>
 #include <Database.hpp>
+#include <EntityCache.hpp>
 #include <Json.hpp>
 #include <RequestHandler.hpp>
+#include <ResponseCache.hpp>
 
 int main()
 {
+    EntityCache cache;
+    ResponseCache responseCache;
+    HandlerContext context{cache, responseCache};
     RestController controller;
-    registerHandlers(controller);
+    registerHandlers(controller, context);
     controller.startController();
     char c;
     while ((c = getchar()) != 'x');